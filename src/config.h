@@ -93,6 +93,14 @@ struct GlobalArgs_t
     unsigned int expPerHDR; // if realTime
     int verbosity;
     int inputs;
+    unsigned int threads; // 0 - hardware concurrency
+    bool halfChroma; // chromaticity of HDR creation at half resolution
+    unsigned int proxyLevels; // luminance statistics on frames decimated by 2^proxyLevels
+    unsigned int strips; // rows of strips of out-of-core HDR creation, 0 - whole frames
+    bool halfFloat; // L and a*b* of float HDR creation stored as half-floats
+    bool rollingWindow; // if realTime, HDR frame from the last expPerHDR exposures after every one
+    unsigned int align; // alignment of inputs: 0 - none, 1 - translation, 2 - with small rotation
+    unsigned int rawPreset; // kernel::GenericFrame::RawPreset of RAW decoding
 };
 
 #endif /* CONFIG_H_ */
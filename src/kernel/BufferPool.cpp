@@ -0,0 +1,127 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include "BufferPool.hpp"
+
+#include <vector>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#include "config.h"
+
+namespace kernel
+{
+
+BufferPool::BufferPool(size_t maxFree)
+        : maxFree(maxFree), allocations(0), reuses(0)
+{
+}
+
+bool BufferPool::isFree(const cv::Mat & m)
+{
+    // Only the pool holds this matrix.
+    return (m.u != NULL) && (m.u->refcount == 1);
+}
+
+cv::Mat BufferPool::get(int rows, int cols, int type)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    unsigned long use = allocations + reuses;
+    for (std::vector<Buffer>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+    {
+        cv::Mat & m = it->matrix;
+        if ((m.rows == rows) && (m.cols == cols) && (m.type() == type) && isFree(m))
+        {
+            reuses++;
+            it->lastUse = use;
+            return m;
+        }
+    }
+
+    // Least recently used free matrices over the limit won't be used any more.
+    std::vector<Buffer>::iterator freeEnd = std::partition(buffers.begin(), buffers.end(),
+            [](const Buffer & buffer)
+            {
+                return isFree(buffer.matrix);
+            });
+    size_t free = freeEnd - buffers.begin();
+    if (free >= maxFree)
+    {
+        std::vector<Buffer>::iterator keptFree = freeEnd - (maxFree > 0 ? maxFree - 1 : 0);
+        std::nth_element(buffers.begin(), keptFree, freeEnd,
+                [](const Buffer & a, const Buffer & b)
+                {
+                    return a.lastUse < b.lastUse;
+                });
+        buffers.erase(buffers.begin(), keptFree);
+    }
+
+    allocations++;
+    debug_print(LVL_DEBUG, "Buffer pool allocates %dx%d of type %d, %lu buffers.\n", rows, cols,
+            type, (unsigned long) buffers.size() + 1);
+    Buffer buffer =
+    { cv::Mat(rows, cols, type), use };
+    buffers.push_back(buffer);
+    return buffers.back().matrix;
+}
+
+cv::Mat BufferPool::get(cv::Size size, int type)
+{
+    return get(size.height, size.width, type);
+}
+
+void BufferPool::trim()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](const Buffer & buffer)
+    {
+        return isFree(buffer.matrix);
+    }), buffers.end());
+}
+
+unsigned long BufferPool::getAllocations()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return allocations;
+}
+
+unsigned long BufferPool::getReuses()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return reuses;
+}
+
+size_t BufferPool::size()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return buffers.size();
+}
+
+} /* namespace kernel */
@@ -0,0 +1,92 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef BUFFERPOOL_HPP_
+#define BUFFERPOOL_HPP_
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace kernel
+{
+
+/*
+ * Pool of matrices keyed by size and type.
+ *
+ * Matrix returned by @method get is reused by next calls as soon as nobody
+ * except the pool references it any more. Matrices of every size and type
+ * in use are kept, when a new one has to be allocated and there are more
+ * not referenced matrices than the limit, the least recently used of them
+ * are released.
+ */
+class BufferPool
+{
+private:
+    struct Buffer
+    {
+        cv::Mat matrix;
+        unsigned long lastUse;
+    };
+
+    boost::mutex mutex;
+    std::vector<Buffer> buffers;
+    size_t maxFree;
+
+    unsigned long allocations;
+    unsigned long reuses;
+
+    static bool isFree(const cv::Mat & m);
+public:
+    /**
+     * Pool keeping at most @param maxFree not referenced matrices.
+     */
+    explicit BufferPool(size_t maxFree = 64);
+
+    /**
+     * Matrix of @param rows x @param cols and @param type, content is undefined.
+     * Thread safe.
+     */
+    cv::Mat get(int rows, int cols, int type);
+    cv::Mat get(cv::Size size, int type);
+
+    /**
+     * Release all matrices which are not referenced outside of the pool.
+     */
+    void trim();
+
+    unsigned long getAllocations();
+    unsigned long getReuses();
+    size_t size();
+};
+
+} /* namespace kernel */
+
+#endif /* BUFFERPOOL_HPP_ */
@@ -105,55 +105,72 @@ void ExposureValue::setISO(float iso)
 }
 
 // From Libpfs
-void ExposureValue::setFromExif(const std::string& filename)
+static void setFromImage(::Exiv2::Image::AutoPtr image, ExposureValue & ev)
 {
-    typedef ::Exiv2::Image::AutoPtr ImgPtr;
     typedef ::Exiv2::ExifData ExifData;
     typedef ::Exiv2::ExifData::const_iterator DataIterator;
-    try
-    {
-        ImgPtr image = Exiv2::ImageFactory::open(filename);
-        image->readMetadata();
-        ExifData &exifData = image->exifData();
 
-        if (exifData.empty()) return;
+    image->readMetadata();
+    ExifData &exifData = image->exifData();
 
-        DataIterator it = exifData.end();
-        if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ExposureTime"))) != exifData.end())
-        {
-            setShutterSpeed(it->toFloat());
-        }
-        else if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ShutterSpeedValue")))
-                != exifData.end())
-        {
-            long num = 1;
-            long div = 1;
-            float tmp = std::exp(std::log(2.0f) * it->toFloat());
-            if (tmp > 1)
-            {
-                div = static_cast<long>(tmp + 0.5f);
-            }
-            else
-            {
-                num = static_cast<long>(1.0f / tmp + 0.5f);
-            }
-            setShutterSpeed(static_cast<float>(num) / div);
-        }
+    if (exifData.empty()) return;
 
-        if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.FNumber"))) != exifData.end())
+    DataIterator it = exifData.end();
+    if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ExposureTime"))) != exifData.end())
+    {
+        ev.setShutterSpeed(it->toFloat());
+    }
+    else if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ShutterSpeedValue")))
+            != exifData.end())
+    {
+        long num = 1;
+        long div = 1;
+        float tmp = std::exp(std::log(2.0f) * it->toFloat());
+        if (tmp > 1)
         {
-            setAperture(it->toFloat());
+            div = static_cast<long>(tmp + 0.5f);
         }
-        else if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ApertureValue")))
-                != exifData.end())
+        else
         {
-            setAperture(static_cast<float>(expf(logf(2.0f) * it->toFloat() / 2.f)));
+            num = static_cast<long>(1.0f / tmp + 0.5f);
         }
+        ev.setShutterSpeed(static_cast<float>(num) / div);
+    }
 
-        if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ISOSpeedRatings"))) != exifData.end())
-        {
-            setISO(it->toFloat());
-        }
+    if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.FNumber"))) != exifData.end())
+    {
+        ev.setAperture(it->toFloat());
+    }
+    else if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ApertureValue")))
+            != exifData.end())
+    {
+        ev.setAperture(static_cast<float>(expf(logf(2.0f) * it->toFloat() / 2.f)));
+    }
+
+    if ((it = exifData.findKey(Exiv2::ExifKey("Exif.Photo.ISOSpeedRatings"))) != exifData.end())
+    {
+        ev.setISO(it->toFloat());
+    }
+}
+
+void ExposureValue::setFromExif(const std::string& filename)
+{
+    try
+    {
+        setFromImage(Exiv2::ImageFactory::open(filename), *this);
+    }
+    catch (Exiv2::AnyError& e)
+    {
+        return;
+    }
+}
+
+void ExposureValue::setFromExif(const unsigned char * data, size_t size)
+{
+    try
+    {
+        // Exiv2 reads the buffer in place, nothing is copied nor opened.
+        setFromImage(Exiv2::ImageFactory::open(data, static_cast<long>(size)), *this);
     }
     catch (Exiv2::AnyError& e)
     {
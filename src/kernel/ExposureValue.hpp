@@ -30,6 +30,7 @@
 #ifndef EXPOSUREVALUE_HPP_
 #define EXPOSUREVALUE_HPP_
 
+#include <cstddef>
 #include <ostream>
 #include <string>
 
@@ -55,6 +56,10 @@ public:
     void setISO(float iso);
 
     void setFromExif(const std::string & filename);
+    /**
+     * As above, but from the file already read to @param data of @param size bytes.
+     */
+    void setFromExif(const unsigned char * data, size_t size);
 
     float get() const;
 
@@ -28,8 +28,14 @@
  *
  */
 #include "GenericFrame.hpp"
+#include "BufferPool.hpp"
+#include "HDRExposition.hpp"
+#include "MappedFile.hpp"
 #include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <string>
+#include <vector>
 #ifdef __APPLE__
 #include <libraw.h>
 #else
@@ -176,6 +182,31 @@ bool GenericFrame::convertToDepth(int newDepth)
 
     if (newDepth == oldDepth) return true;
 
+    if (color == COLOR_CIELab)
+    {
+        // 8-bit Lab is L * 255 / 100 and a*b* + 128, not a fraction of the unit.
+        Mat converted;
+        if ((oldDepth == CV_8U) && (newDepth == CV_32F))
+        {
+            debug_puts("depth change of Lab, from CV_8U to CV_32F\n");
+            multiply(frame, Scalar(100. / MAX_8U, 1, 1), converted, 1, newDepthWithChannels);
+            add(converted, Scalar(0, -128, -128), converted);
+        }
+        else if ((oldDepth == CV_32F) && (newDepth == CV_8U))
+        {
+            debug_puts("depth change of Lab, from CV_32F to CV_8U\n");
+            multiply(frame, Scalar(MAX_8U / 100., 1, 1), converted);
+            add(converted, Scalar(0, 128, 128), converted, Mat(), newDepthWithChannels);
+        }
+        else
+        {
+            // There is no 16-bit Lab.
+            return false;
+        }
+        frame = converted;
+        return true;
+    }
+
     switch (oldDepth)
     {
         case CV_32F:
@@ -296,10 +327,64 @@ bool filenameExtAimsRaw(const std::string & filename)
     return false;
 }
 
+/**
+ * OpenCV decoders of these formats (Radiance, OpenEXR, JPEG 2000) cannot read from memory,
+ * imdecode would write the bytes to a temporary file and read it again.
+ */
+static bool filenameExtDecodesFromFileOnly(const std::string & filename)
+{
+    const std::string extensions[] = { "hdr", "pic", "exr", "jp2" };
+    if (filename.find_last_of(".") == std::string::npos) return false;
+    std::string ext = filename.substr(filename.find_last_of(".") + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return std::find(std::begin(extensions), std::end(extensions), ext) != std::end(extensions);
+}
+
+static const char * const rawPresetNames[GenericFrame::RAW_PRESETS] = { "quality", "fast", "half",
+        "thumbnail" };
+
+bool GenericFrame::readsWholeFiles(const GlobalArgs_t & globalArgs)
+{
+    return globalArgs.rawPreset != RAW_THUMBNAIL;
+}
+
+int GenericFrame::inputToReadAhead(const GlobalArgs_t & globalArgs, int input, int workers)
+{
+    const int next = input + workers;
+    if ((next >= globalArgs.inputs) || !readsWholeFiles(globalArgs)) return -1;
+    return next;
+}
+
+bool GenericFrame::rawPresetOf(const char * name, unsigned int & preset)
+{
+    for (unsigned int p = 0; p < RAW_PRESETS; ++p)
+    {
+        if (strcmp(name, rawPresetNames[p]) == 0)
+        {
+            preset = p;
+            return true;
+        }
+    }
+    return false;
+}
+
 #define CR(F) if ((F) != LIBRAW_SUCCESS) goto err
 #define Pm processor.imgdata.params
 void GenericFrame::setParams(LibRaw & processor)
 {
+    switch (globalArgs.rawPreset)
+    {
+        case RAW_FAST:
+            Pm.user_qual = 0; // linear interpolation
+        break;
+        case RAW_HALF:
+        case RAW_THUMBNAIL: // used when there is no usable thumbnail
+            Pm.half_size = 1; // 2x2 blocks are pixels, no demosaic
+        break;
+        default:
+            // Demosaic of LibRaw's defaults is kept.
+        break;
+    }
     Pm.exp_correc = 0;
     Pm.no_auto_bright = 1;
     Pm.use_auto_wb = 0;
@@ -310,63 +395,231 @@ void GenericFrame::setParams(LibRaw & processor)
 }
 #undef Pm
 
-bool GenericFrame::readRaw(const std::string & filename)
+/**
+ * Output curve of dcraw_make_mem_image (dcraw's gamma_curve of @param power and @param toeSlope
+ * up to @param white) scaled to [0, 1].
+ */
+static std::vector<float> outputCurve(double power, double toeSlope, double white)
+{
+    double g[5] = { power, toeSlope, 0, 0, 0 };
+    double bounds[2] = { 0, 0 };
+    bounds[g[1] >= 1] = 1;
+    if (g[1] && ((g[1] - 1) * (g[0] - 1) <= 0))
+    {
+        for (int i = 0; i < 48; ++i)
+        {
+            g[2] = (bounds[0] + bounds[1]) / 2;
+            if (g[0])
+                bounds[(std::pow(g[2] / g[1], -g[0]) - 1) / g[0] - 1 / g[2] > -1] = g[2];
+            else
+                bounds[g[2] / std::exp(1 - 1 / g[2]) < g[1]] = g[2];
+        }
+        g[3] = g[2] / g[1];
+        if (g[0]) g[4] = g[2] * (1 / g[0] - 1);
+    }
+    std::vector<float> curve(0x10000);
+    for (int i = 0; i < 0x10000; ++i)
+    {
+        const double r = i / white;
+        double value = 1;
+        if (r < 1)
+        {
+            value = (r < g[3]) ? r * g[1]
+                    : (g[0] ? std::pow(r, g[0]) * (1 + g[4]) - g[4] : std::log(r) * g[2] + 1);
+        }
+        // As 16-bit output of LibRaw, ((1 << 16) - 1) at most.
+        curve[i] = std::min<int>(0x10000 * value, 0xffff) / 65535.f;
+    }
+    return curve;
+}
+
+/**
+ * Processed image of @param processor converted to CIE L*a*b* (CV_32FC3 or CV_8UC3,
+ * of PixelType) straight into @param lab, in strips of rows which fit in cache.
+ * Pixels are read from LibRaw's image the way dcraw_make_mem_image copies them:
+ * turned by flip and mapped by the output @param curve.
+ */
+template<typename PixelType>
+static void rawToLab(LibRaw & processor, const std::vector<PixelType> & curve, cv::Mat & lab)
 {
-    int W = 0, H = 0;
-    libraw_processed_image_t *image = NULL;
-    cv::Mat preprocess;
+    // After processing the image has width x height pixels (as in copy_mem_image),
+    // iwidth and iheight aren't updated by stretching and rotation of Fuji sensors.
+    const int flip = processor.imgdata.sizes.flip;
+    const int iwidth = processor.imgdata.sizes.width;
+    const int iheight = processor.imgdata.sizes.height;
+    const ushort (*image)[4] = processor.imgdata.image;
+    const size_t rowBytes = lab.cols * 3 * sizeof(PixelType) * 2; // RGB and Lab
+    const int stripRows = std::max<int>(1, l2CacheSize() / rowBytes);
+    const int strips = (lab.rows + stripRows - 1) / stripRows;
+    parallelForRows(strips,
+            [&lab, &curve, flip, iwidth, iheight, image, stripRows](const cv::Range & range)
+            {
+                cv::Mat rgb;
+                for (int strip = range.start; strip < range.end; ++strip)
+                {
+                    cv::Range rows(strip * stripRows, std::min((strip + 1) * stripRows, lab.rows));
+                    rgb.create(rows.size(), lab.cols, lab.type());
+                    for (int row = rows.start; row < rows.end; ++row)
+                    {
+                        PixelType * dst = rgb.ptr<PixelType>(row - rows.start);
+                        for (int col = 0; col < lab.cols; ++col, dst += 3)
+                        {
+                            int r = row, c = col;
+                            if (flip & 4) std::swap(r, c);
+                            if (flip & 2) r = iheight - 1 - r;
+                            if (flip & 1) c = iwidth - 1 - c;
+                            const ushort * pixel = image[r * iwidth + c];
+                            dst[0] = curve[pixel[0]];
+                            dst[1] = curve[pixel[1]];
+                            dst[2] = curve[pixel[2]];
+                        }
+                    }
+                    cv::Mat out = lab.rowRange(rows);
+                    cvtColor(rgb, out, CV_RGB2Lab);
+                }
+            });
+}
+
+/**
+ * Embedded preview of the opened RAW in @param processor to BGR @param bgr, oriented like the
+ * decoded image. False if there is none or it is neither JPEG nor an 8-bit RGB bitmap.
+ */
+static bool thumbnailOf(LibRaw & processor, cv::Mat & bgr)
+{
+    if (processor.unpack_thumb() != LIBRAW_SUCCESS) return false;
+    const libraw_thumbnail_t & thumbnail = processor.imgdata.thumbnail;
+    if (thumbnail.tformat == LIBRAW_THUMBNAIL_JPEG)
+    {
+        // Decoded straight from LibRaw's buffer, JPEG data is not copied.
+        cv::Mat jpeg(1, thumbnail.tlength, CV_8U, thumbnail.thumb);
+        bgr = cv::imdecode(jpeg, CV_LOAD_IMAGE_COLOR);
+    }
+    else if ((thumbnail.tformat == LIBRAW_THUMBNAIL_BITMAP) && (thumbnail.tcolors == 3)
+            && (thumbnail.tlength >= 3u * thumbnail.twidth * thumbnail.theight))
+    {
+        cv::Mat rgb(thumbnail.theight, thumbnail.twidth, CV_8UC3, thumbnail.thumb);
+        cvtColor(rgb, bgr, CV_RGB2BGR);
+    }
+    if (bgr.empty()) return false;
+
+    // Same orientation as rawToLab gives.
+    int flip = processor.imgdata.sizes.flip;
+    if (flip & 3) cv::flip(bgr, bgr, ((flip & 3) == 3) ? -1 : ((flip & 2) ? 0 : 1));
+    if (flip & 4) cv::transpose(bgr, bgr);
+    return true;
+}
+
+#define Pm processor.imgdata.params
+bool GenericFrame::readRaw(const std::string & filename, BufferPool * pool)
+{
+    int W = 0, H = 0, depth = CV_32F;
+    std::vector<float> curve;
     ExposureValue ev(0);
 
+    // Mapping outlives the processor, which reads it until recycled.
+    MappedFile file;
     LibRaw processor;
     setParams(processor);
-    CR(processor.open_file(filename.c_str()));
-    CR(processor.unpack());
-    CR(processor.dcraw_process());
+    // Only the thumbnail and metadata are read for RAW_THUMBNAIL.
+    if (file.open(filename, readsWholeFiles(globalArgs)))
+    {
+        // LibRaw only reads the buffer.
+        CR(processor.open_buffer(const_cast<unsigned char *>(file.bytes()), file.size()));
+    }
+    else
+    {
+        CR(processor.open_file(filename.c_str()));
+    }
     debug_print(LVL_INFO, "Opened RAW file (%d x %d). Model %s, Shutter: %f, aperature: %f.\n",
             processor.imgdata.sizes.width, processor.imgdata.sizes.height,
             processor.imgdata.idata.model, processor.imgdata.other.shutter,
             processor.imgdata.other.aperture);
+    // EXIF is parsed by open_file, thumbnails get the EV of the RAW.
     ev = ExposureValue(processor.imgdata.other.shutter, processor.imgdata.other.aperture,
             processor.imgdata.other.iso_speed);
     setEV(ev);
 
-    image = processor.dcraw_make_mem_image();
-    if (!image) goto err;
+    if (globalArgs.rawPreset == RAW_THUMBNAIL)
+    {
+        // Neither the sensor data is unpacked nor processed.
+        if (thumbnailOf(processor, frame))
+        {
+            color = COLOR_BGR;
+            processor.recycle();
+            return true;
+        }
+        verbose_print(globalArgs.verbosity, "No usable thumbnail in %s, decoding it at half size.",
+                filename.c_str());
+    }
+    CR(processor.unpack());
+    CR(processor.dcraw_process());
 
-    W = image->width;
-    H = image->height;
-    assert(W == processor.imgdata.sizes.width);
-    assert(image->data_size == W * H * 3 * sizeof(uint16_t));
+    // Processed image is read in place, no 16-bit copy of it is made.
+    if ((processor.imgdata.image == NULL) || (processor.imgdata.idata.colors != 3)) goto err;
+    W = processor.imgdata.sizes.width;
+    H = processor.imgdata.sizes.height;
+    if (processor.imgdata.sizes.flip & 4) std::swap(W, H);
 
-    preprocess = cv::Mat(H, W, CV_16UC3, image->data);
-    frame = cv::Mat(H, W, CV_32FC3);
+    // Curve without automatic brightness, which setParams disables.
+    curve = outputCurve(Pm.gamm[0], Pm.gamm[1], (0x2000 << 3) / Pm.bright);
+    depth = (globalArgs.rawPreset == RAW_QUALITY) ? CV_32F : CV_8U;
+    frame = pool ? pool->get(H, W, CV_MAKETYPE(depth, 3)) : cv::Mat(H, W, CV_MAKETYPE(depth, 3));
     debug_puts("START: Changind RAW colorspace to CIE L*a*b*\n");
-    preprocess.convertTo(preprocess, CV_32FC3, 1. / 65535); // ((1 << 16) - 1)
-    cvtColor(preprocess, frame, CV_RGB2Lab);
+    if (depth == CV_8U)
+    {
+        std::vector<unsigned char> curve8(curve.size());
+        std::transform(curve.begin(), curve.end(), curve8.begin(), [](float v)
+        {
+            return cv::saturate_cast<unsigned char>(v * 255);
+        });
+        rawToLab(processor, curve8, frame);
+    }
+    else
+    {
+        rawToLab(processor, curve, frame);
+    }
     debug_puts("DONE: Changind RAW colorspace to CIE L*a*b*\n");
     color = COLOR_CIELab;
 
-    LibRaw::dcraw_clear_mem(image);
     processor.recycle();
     return true;
     err: processor.recycle();
     return false;
 }
+#undef Pm
 #undef CR
 
-bool GenericFrame::getFrameFromFile(const std::string & filename)
+bool GenericFrame::getFrameFromFile(const std::string & filename, BufferPool * pool)
 {
     if (filenameExtAimsRaw(filename))
     {
-        readRaw(filename);
+        readRaw(filename, pool);
     }
-    else
+    else if (filenameExtDecodesFromFileOnly(filename))
     {
         frame = cv::imread(filename,
                 CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR | CV_LOAD_IMAGE_UNCHANGED);
         color = COLOR_BGR;
         ev.setFromExif(filename);
     }
+    else
+    {
+        // Pixels and EXIF come from a single mapping of the file.
+        MappedFile file;
+        if (file.open(filename))
+        {
+            cv::Mat bytes(1, static_cast<int>(file.size()), CV_8U,
+                    const_cast<unsigned char *>(file.bytes()));
+            frame = cv::imdecode(bytes,
+                    CV_LOAD_IMAGE_ANYDEPTH | CV_LOAD_IMAGE_COLOR | CV_LOAD_IMAGE_UNCHANGED);
+            ev.setFromExif(file.bytes(), file.size());
+        }
+        else
+        {
+            frame.release();
+        }
+        color = COLOR_BGR;
+    }
     std::stringstream ss;
     ss << ev;
     verbose_print(globalArgs.verbosity, "File %s (%d, %d; %s) loaded.", filename.c_str(),
@@ -44,6 +44,8 @@
 namespace kernel
 {
 
+class BufferPool;
+
 /*
  * This is a cv::Mat wrapper.
  */
@@ -53,6 +55,36 @@ public:
     enum ColorSpace {
         COLOR_BGR, COLOR_RGB, COLOR_CIEXYZ, COLOR_CIELab, COLOR_UNDEFINED
     };
+
+    /*
+     * RAW decoding presets (globalArgs.rawPreset), from the best to the fastest.
+     */
+    enum RawPreset {
+        RAW_QUALITY, // full size, LibRaw's default demosaic, float Lab
+        RAW_FAST, // full size, linear demosaic, 8-bit Lab
+        RAW_HALF, // half size without demosaic, 8-bit Lab
+        RAW_THUMBNAIL, // embedded preview, 8-bit BGR, RAW_HALF if there is none
+        RAW_PRESETS
+    };
+
+    /**
+     * Preset of @param name ("quality", "fast", "half" or "thumbnail") to @param preset,
+     * false for unknown names.
+     */
+    static bool rawPresetOf(const char * name, unsigned int & preset);
+
+    /**
+     * Input files of @param globalArgs are read whole, not with RAW thumbnails,
+     * which are a small part of their files.
+     */
+    static bool readsWholeFiles(const GlobalArgs_t & globalArgs);
+
+    /**
+     * Input to read ahead when input @param input is loaded by one of @param workers:
+     * the first one waiting for a free worker, -1 if there is none or if files
+     * aren't read whole.
+     */
+    static int inputToReadAhead(const GlobalArgs_t & globalArgs, int input, int workers);
 private:
     bool dirty;
     cv::Mat frame;
@@ -62,7 +94,7 @@ private:
     const GlobalArgs_t & globalArgs;
 
     inline void frameModified();
-    bool readRaw(const std::string & filename);
+    bool readRaw(const std::string & filename, BufferPool * pool);
     void setParams(LibRaw & processor);
 
 public:
@@ -102,9 +134,9 @@ public:
     bool assignFrameTo(cv::Mat & frame, ColorSpace color);
 
 	/**
-	 * Read file
+	 * Read file, decoded RAW is written to a buffer of @param pool if given.
 	 */
-	bool getFrameFromFile(const std::string & filename);
+	bool getFrameFromFile(const std::string & filename, BufferPool * pool = NULL);
 
 	/**
 	 * Get frame from device
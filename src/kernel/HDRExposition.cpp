@@ -30,103 +30,175 @@
 #include "HDRExposition.hpp"
 
 #include <vector>
+#include <algorithm>
+#include <unistd.h>
 #include <opencv2/opencv.hpp>
 
 namespace kernel
 {
 
 template<typename PixelType>
-void GlobalOperation<PixelType>::apply(cv::Mat & output, std::vector<cv::Mat> & inputs)
+void GlobalOperation<PixelType>::applyRows(cv::Mat & output, std::vector<cv::Mat> & inputs,
+        const cv::Range & rows)
 {
-    typedef cv::MatConstIterator_<PixelType> it_t;
+    assert(output.elemSize() == sizeof(PixelType));
     unsigned int noOfExp = inputs.size();
-    PixelType* expositions = new PixelType[noOfExp];
-    it_t* itrtrs = new it_t[noOfExp];
-    it_t* ends = new it_t[noOfExp];
-    unsigned int exp = 0;
-    for_each(inputs.begin(), inputs.end(), [&itrtrs, &ends, &exp](cv::Mat & input)
+    // Every band has its own spans.
+    std::vector<const PixelType *> spans(noOfExp);
+
+    bool continuous = output.isContinuous();
+    std::for_each(inputs.begin(), inputs.end(), [&continuous](cv::Mat & input)
     {
-        ends[exp] = input.end<PixelType>();
-        itrtrs[exp++] = input.begin<PixelType>();
+        continuous &= input.isContinuous();
     });
+    // Continuous band is processed as one span.
+    int rowsPerSpan = continuous ? rows.size() : 1;
 
-    std::for_each(output.begin<PixelType>(), output.end<PixelType>(),
-            [this, &noOfExp, &itrtrs, &ends, &expositions](PixelType &p)
-            {
-                for (int exp = 0; exp < noOfExp; exp++)
-                {
-                    assert(itrtrs[exp] != ends[exp]);
-                    expositions[exp] = *itrtrs[exp];
-                    itrtrs[exp]++;
-                }
-                p = process(expositions, noOfExp);
-            });
+    for (int row = rows.start; row < rows.end; row += rowsPerSpan)
+    {
+        for (unsigned int exp = 0; exp < noOfExp; ++exp)
+        {
+            spans[exp] = inputs[exp].ptr<PixelType>(row);
+        }
+        this->processSpan(spans.data(), noOfExp, output.ptr<PixelType>(row),
+                (size_t) output.cols * rowsPerSpan);
+    }
+}
 
-    delete[] ends;
-    delete[] itrtrs;
-    delete[] expositions;
+template<typename PixelType>
+void GlobalOperation<PixelType>::apply(cv::Mat & output, std::vector<cv::Mat> & inputs)
+{
+    if (!this->isElementWise())
+    {
+        applyRows(output, inputs, cv::Range(0, output.rows));
+        return;
+    }
+    parallelForRows(output.rows, [this, &output, &inputs](const cv::Range & rows)
+    {
+        applyRows(output, inputs, rows);
+    });
 }
 
 template<typename PixelType, typename PartitionType, typename PartitionShift>
 void LocalOperation<PixelType, PartitionType, PartitionShift>::apply(cv::Mat & output,
         std::vector<cv::Mat> & inputs)
 {
-    typedef typename Partition<PixelType, PartitionType, PartitionShift>::template PartitionIterator<
-            PixelType> iterator;
-    std::vector<std::vector<iterator>> partitionsIts;
-    std::vector<std::vector<iterator>> partitionsEnds;
-
+    typedef typename Partition<PixelType, PartitionType, PartitionShift>::span_t span_t;
     unsigned int noOfExp = inputs.size();
-    PixelType* expositions = new PixelType[noOfExp];
     debug_print(LVL_DEBUG, "Applying local, with partitions. No of expositions = %d.\n", noOfExp);
+    assert(output.elemSize() == sizeof(PixelType));
 
-    std::for_each(inputs.begin(), inputs.end(),
-            [this, &partitionsIts, &partitionsEnds](cv::Mat & input)
-            {
-                partitionsIts.push_back(partitions.template listOfBegins<PixelType>(input));
-                partitionsEnds.push_back(partitions.template listOfEnds<PixelType>(input));
-            });
-    std::vector<iterator> outputPartitionsIts, outputPartitionsEnds;
-    outputPartitionsIts = partitions.template listOfBegins<PixelType>(output);
-    outputPartitionsEnds = partitions.template listOfEnds<PixelType>(output);
-    debug_print(LVL_DEBUG, "Divided into %lu partitions.\n", outputPartitionsIts.size());
+    if (isMergeable())
+    {
+        applyMerged(output, inputs);
+        return;
+    }
 
-    assert(partitions.size() == outputPartitionsIts.size());
+    std::vector<const PixelType *> spans(noOfExp);
     for (PartitionType ident = 0; ident < partitions.size(); ++ident)
     {
         enterArea(ident);
-
-        std::vector<iterator> inputsIt;
-        std::for_each(partitionsIts.begin(), partitionsIts.end(),
-                [&inputsIt, &ident](std::vector<iterator> & currentExpositionIterators)
+        const typename Partition<PixelType, PartitionType, PartitionShift>::spans_t & area =
+                partitions.spans(ident);
+        std::for_each(area.begin(), area.end(),
+                [this, &spans, &inputs, &output, noOfExp](const span_t & span)
                 {
-                    inputsIt.push_back(currentExpositionIterators[ident]);
+                    for (unsigned int exp = 0; exp < noOfExp; ++exp)
+                    {
+                        spans[exp] = inputs[exp].ptr<PixelType>(span.row) + span.start;
+                    }
+                    this->processSpan(spans.data(), noOfExp,
+                            output.ptr<PixelType>(span.row) + span.start, span.length);
                 });
+        leaveArea(ident);
+    }
+}
+
+template<typename PixelType, typename PartitionType, typename PartitionShift>
+void LocalOperation<PixelType, PartitionType, PartitionShift>::applyMerged(cv::Mat & output,
+        std::vector<cv::Mat> & inputs)
+{
+    typedef typename Partition<PixelType, PartitionType, PartitionShift>::spans_t spans_t;
+    // Chunk is a range of spans [first, last) of area ident.
+    struct Chunk
+    {
+        PartitionType ident;
+        size_t first, last;
+    };
+    static const size_t pixelsPerChunk = 1 << 16;
 
-        std::for_each(outputPartitionsIts[ident], outputPartitionsEnds[ident],
-                [this, &expositions, &inputsIt, &noOfExp, &ident, &partitionsEnds](PixelType & outputValue)
+    unsigned int noOfExp = inputs.size();
+    std::vector<Chunk> chunks;
+    for (PartitionType ident = 0; ident < partitions.size(); ++ident)
+    {
+        enterArea(ident);
+        const spans_t & area = partitions.spans(ident);
+        size_t pixels = 0;
+        Chunk chunk = { ident, 0, 0 };
+        for (size_t span = 0; span < area.size(); ++span)
+        {
+            pixels += area[span].length;
+            if (pixels >= pixelsPerChunk)
+            {
+                chunk.last = span + 1;
+                chunks.push_back(chunk);
+                chunk.first = chunk.last;
+                pixels = 0;
+            }
+        }
+        chunk.last = area.size();
+        if (chunk.first != chunk.last) chunks.push_back(chunk);
+    }
+    debug_print(LVL_DEBUG, "Applying local in parallel, %lu chunks.\n", chunks.size());
+
+    std::vector<AreaStatePtr> states(chunks.size());
+    parallelForRows(chunks.size(),
+            [this, &chunks, &states, &inputs, &output, noOfExp](const cv::Range & range)
+            {
+                std::vector<const PixelType *> spans(noOfExp);
+                for (int c = range.start; c < range.end; ++c)
                 {
-                    unsigned int exp = 0;
-                    std::for_each(inputsIt.begin(), inputsIt.end(), [&exp, &expositions, &ident, &partitionsEnds](iterator & inputExpValue)
-                            {
-                                assert(inputExpValue != partitionsEnds[exp][ident]);
-                                expositions[exp] = *inputExpValue;
-                                ++inputExpValue;
-                                exp++;
-                            });
-                    assert(noOfExp == exp);
-                    outputValue = process(expositions, noOfExp);
-                });
+                    const Chunk & chunk = chunks[c];
+                    const spans_t & area = partitions.spans(chunk.ident);
+                    states[c] = createAreaState(chunk.ident);
+                    for (size_t span = chunk.first; span < chunk.last; ++span)
+                    {
+                        for (unsigned int exp = 0; exp < noOfExp; ++exp)
+                        {
+                            spans[exp] = inputs[exp].ptr<PixelType>(area[span].row) + area[span].start;
+                        }
+                        processAreaSpan(*states[c], spans.data(), noOfExp,
+                                output.ptr<PixelType>(area[span].row) + area[span].start,
+                                area[span].length);
+                    }
+                }
+            });
 
+    // Chunks are in order of areas.
+    size_t c = 0;
+    for (PartitionType ident = 0; ident < partitions.size(); ++ident)
+    {
+        for (; (c < chunks.size()) && (chunks[c].ident == ident); ++c)
+        {
+            mergeArea(ident, *states[c]);
+        }
         leaveArea(ident);
     }
+}
 
-    delete[] expositions;
+size_t l2CacheSize()
+{
+    static const size_t defaultL2CacheSize = 256 * 1024;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (size > 0) return size;
+#endif
+    return defaultL2CacheSize;
 }
 
 template<typename PixelType>
 HDRExposition<PixelType>::HDRExposition(cv::Mat& output, std::vector<cv::Mat> inputs)
-        : output(output), inputs(inputs)
+        : output(output), inputs(inputs), tileBytes(l2CacheSize())
 {
 }
 
@@ -138,23 +210,99 @@ HDRExposition<PixelType>& HDRExposition<PixelType>::addOperation(Operation<Pixel
 }
 
 template<typename PixelType>
-cv::Mat& HDRExposition<PixelType>::process()
+HDRExposition<PixelType>& HDRExposition<PixelType>::setTileBytes(size_t tileBytes)
 {
-    std::for_each(operations.begin(), operations.end(), [this](Operation<PixelType> & op)
+    this->tileBytes = tileBytes;
+    return *this;
+}
+
+template<typename PixelType>
+void HDRExposition<PixelType>::streamTiles(typename operations_t::iterator first,
+        typename operations_t::iterator last)
+{
+    size_t rowBytes = output.cols * output.elemSize();
+    std::for_each(inputs.begin(), inputs.end(), [this, &rowBytes](cv::Mat & input)
     {
-        std::for_each(inputs.begin(), inputs.end(), [&op](cv::Mat& m)
-                {   m = op.preprocess(m);});
-        op.apply(output, inputs);
-        std::for_each(inputs.begin(), inputs.end(), [&op](cv::Mat& m)
-                {   m = op.postprocess(m);});
+        assert(input.rows == output.rows);
+        rowBytes += input.cols * input.elemSize();
     });
+    int tileRows = std::max<int>(1, tileBytes / std::max<size_t>(1, rowBytes));
+    debug_print(LVL_DEBUG, "Streaming %ld operations in tiles of %d rows.\n",
+            (long) std::distance(first, last), tileRows);
+
+    int noOfTiles = (output.rows + tileRows - 1) / tileRows;
+    parallelForRows(noOfTiles, [this, first, last, tileRows](const cv::Range & tiles)
+    {
+        std::vector<cv::Mat> inputTiles(inputs.size());
+        for (int tile = tiles.start; tile < tiles.end; ++tile)
+        {
+            cv::Range rows(tile * tileRows, std::min((tile + 1) * tileRows, output.rows));
+            cv::Mat outputTile = output.rowRange(rows);
+            for (unsigned int exp = 0; exp < inputs.size(); ++exp)
+            {
+                inputTiles[exp] = inputs[exp].rowRange(rows);
+            }
+
+            std::for_each(first, last, [&outputTile, &inputTiles](Operation<PixelType> & op)
+            {
+                // Element-wise operations work in place, tile is a view on the whole frame.
+                std::for_each(inputTiles.begin(), inputTiles.end(), [&op](cv::Mat& m)
+                {
+                    uchar * data = op.preprocess(m).data;
+                    assert(data == m.data);
+                    (void) data;
+                });
+                op.apply(outputTile, inputTiles);
+                std::for_each(inputTiles.begin(), inputTiles.end(), [&op](cv::Mat& m)
+                {
+                    uchar * data = op.postprocess(m).data;
+                    assert(data == m.data);
+                    (void) data;
+                });
+            });
+        }
+    });
+}
+
+template<typename PixelType>
+cv::Mat& HDRExposition<PixelType>::process()
+{
+    typename operations_t::iterator op = operations.begin();
+    while (op != operations.end())
+    {
+        typename operations_t::iterator chainEnd = op;
+        while ((tileBytes > 0) && (chainEnd != operations.end()) && chainEnd->get().isElementWise())
+        {
+            chainEnd++;
+        }
+
+        if (std::distance(op, chainEnd) > 1)
+        {
+            streamTiles(op, chainEnd);
+            op = chainEnd;
+            continue;
+        }
+
+        // Barrier, operation is applied to the whole frame.
+        Operation<PixelType> & current = *op;
+        std::for_each(inputs.begin(), inputs.end(), [&current](cv::Mat& m)
+                {   m = current.preprocess(m);});
+        current.apply(output, inputs);
+        std::for_each(inputs.begin(), inputs.end(), [&current](cv::Mat& m)
+                {   m = current.postprocess(m);});
+        op++;
+    }
     return output;
 }
 
+template class GlobalOperation<unsigned char> ;
+template class GlobalOperation<unsigned short> ;
 template class GlobalOperation<float> ;
+template class LocalOperation<unsigned char, unsigned char, unsigned int> ;
+template class LocalOperation<unsigned short, unsigned char, unsigned int> ;
 template class LocalOperation<float, unsigned char, unsigned int> ;
+template class HDRExposition<unsigned char> ;
+template class HDRExposition<unsigned short> ;
 template class HDRExposition<float> ;
-//template class HDRExposition<cv::Vec3f> ;
-//template class HDRExposition<cv::Vec3b> ;
 
 } /* namespace kernel */
@@ -31,10 +31,13 @@
 #define HDREXPOSITION_HPP_
 
 #include <vector>
+#include <algorithm>
+#include <utility>
 #include <opencv2/opencv.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include <config.h>
+#include "WorkerPool.hpp"
 
 namespace kernel
 {
@@ -43,6 +46,162 @@ namespace kernel
 template<typename PixelType, typename PartitionType, typename PartitionShift>
 class Partition;
 
+/**
+ * Number of bands (of rows) for parallel processing of @param rows.
+ */
+inline int parallelBands(int rows)
+{
+    return std::min<int>(rows, 4 * WorkerPool::shared().size());
+}
+
+/**
+ * Split [0, rows) into bands and execute f(cv::Range band) for every band concurrently
+ * on the shared worker pool.
+ */
+template<typename F>
+void parallelForRows(int rows, const F & f)
+{
+    if (rows <= 0) return;
+    WorkerPool & pool = WorkerPool::shared();
+    WorkerPool::Group group;
+    const int bands = parallelBands(rows);
+    for (int band = 0; band < bands; ++band)
+    {
+        pool.submit(group, [&f, band, bands, rows]()
+        {
+            f(cv::Range(band * rows / bands, (band + 1) * rows / bands));
+        });
+    }
+    pool.wait(group);
+}
+
+/**
+ * Merge kernels are specialised for typical numbers of exposures.
+ * Kernel<N>::run(exps, args...) is a kernel for N exposures known at compile time,
+ * Kernel<0>::run(exps, args...) is the generic one, for any @param exps.
+ */
+template<template<unsigned int> class Kernel, typename ... Args>
+void dispatchExposures(unsigned int exps, Args && ... args)
+{
+    switch (exps)
+    {
+        case 2:
+            Kernel<2>::run(exps, std::forward<Args>(args)...);
+        break;
+        case 3:
+            Kernel<3>::run(exps, std::forward<Args>(args)...);
+        break;
+        case 5:
+            Kernel<5>::run(exps, std::forward<Args>(args)...);
+        break;
+        case 7:
+            Kernel<7>::run(exps, std::forward<Args>(args)...);
+        break;
+        case 9:
+            Kernel<9>::run(exps, std::forward<Args>(args)...);
+        break;
+        default:
+            Kernel<0>::run(exps, std::forward<Args>(args)...);
+    }
+}
+
+/**
+ * Number of exposures in Kernel<N>.
+ */
+template<unsigned int N>
+inline unsigned int exposures(unsigned int exps)
+{
+    return N ? N : exps;
+}
+
+/**
+ * Per exposure values in Kernel<N>, fixed size array (registers) for N > 0.
+ */
+template<typename T, unsigned int N>
+class ExposureArray
+{
+private:
+    T values[N];
+public:
+    explicit ExposureArray(unsigned int exps)
+    {
+    }
+    T & operator[](unsigned int exp)
+    {
+        return values[exp];
+    }
+    T * data()
+    {
+        return values;
+    }
+};
+
+template<typename T>
+class ExposureArray<T, 0>
+{
+private:
+    std::vector<T> values;
+public:
+    explicit ExposureArray(unsigned int exps)
+            : values(exps)
+    {
+    }
+    T & operator[](unsigned int exp)
+    {
+        return values[exp];
+    }
+    T * data()
+    {
+        return values.data();
+    }
+};
+
+/**
+ * Pixel types of expositions. Integer types are fixed-point values in [0, unit()],
+ * float values are in [0, 1].
+ */
+template<typename PixelType>
+struct PixelTraits;
+
+template<>
+struct PixelTraits<unsigned char>
+{
+    enum
+    {
+        depth = CV_8U
+    };
+    static float unit()
+    {
+        return 255;
+    }
+};
+
+template<>
+struct PixelTraits<unsigned short>
+{
+    enum
+    {
+        depth = CV_16U
+    };
+    static float unit()
+    {
+        return 65535;
+    }
+};
+
+template<>
+struct PixelTraits<float>
+{
+    enum
+    {
+        depth = CV_32F
+    };
+    static float unit()
+    {
+        return 1;
+    }
+};
+
 //*************************************************************************************************
 /**
  *
@@ -86,6 +245,18 @@ public:
      */
     virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs) = 0;
 
+    /**
+     * Element-wise operation computes every pixel only from this same pixel
+     * of inputs (and output), it doesn't keep any state between pixels and
+     * preprocess / postprocess are done in place.
+     * Such operation can be applied to any part of the image separately and
+     * concurrently, {@see HDRExposition} will stream it tile by tile.
+     */
+    virtual bool isElementWise() const
+    {
+        return false;
+    }
+
     /**
      * Global matrix function application to every pixel.
      */
@@ -120,6 +291,38 @@ public:
      * iterate with "++" operator to finish just before cv::Mat.end<_>().
      */
     virtual PixelType process(PixelType[], unsigned int exps) = 0;
+
+    /**
+     * Batch version of @method process. Processes @param length consecutive pixels,
+     * inputs[exp] is a contiguous span of exposition exp, output is a span of output.
+     * Default implementation calls @method process for every pixel, override it
+     * with a tight loop where possible.
+     */
+    virtual void processSpan(const PixelType * const inputs[], unsigned int exps,
+            PixelType * output, size_t length)
+    {
+        dispatchExposures<PixelBySpan>(exps, *this, inputs, output, length);
+    }
+
+private:
+    template<unsigned int N>
+    struct PixelBySpan
+    {
+        static void run(unsigned int exps, ProcessingOperation<PixelType> & op,
+                const PixelType * const inputs[], PixelType * output, size_t length)
+        {
+            const unsigned int n = exposures<N>(exps);
+            ExposureArray<PixelType, N> expositions(n);
+            for (size_t i = 0; i < length; ++i)
+            {
+                for (unsigned int exp = 0; exp < n; ++exp)
+                {
+                    expositions[exp] = inputs[exp][i];
+                }
+                output[i] = op.process(expositions.data(), n);
+            }
+        }
+    };
 };
 
 /**
@@ -128,6 +331,9 @@ public:
 template<typename PixelType>
 class GlobalOperation: public ProcessingOperation<PixelType>
 {
+private:
+    void applyRows(cv::Mat & output, std::vector<cv::Mat> & inputs, const cv::Range & rows);
+
 public:
     virtual ~GlobalOperation()
     {
@@ -135,22 +341,122 @@ public:
 
     virtual PixelType process(PixelType[], unsigned int exps) = 0;
 
+    /**
+     * Element-wise operations are applied in parallel, in bands of rows.
+     */
     virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs);
+
+    /**
+     * By default every pixel is processed independently, and @method process
+     * can be called concurrently.
+     * Override if @method process depends on previously processed pixels.
+     */
+    virtual bool isElementWise() const
+    {
+        return true;
+    }
+};
+
+/**
+ * Global reduction computes statistics of expositions (histograms, means, min/max)
+ * and doesn't write any output.
+ *
+ * Image is divided into bands of rows, every band is accumulated concurrently into
+ * its own Accumulator (created with @method initial, filled with @method accumulate).
+ * Accumulators are combined in order of bands (@method combine) and finalised
+ * (@method finalise) into @method result.
+ */
+template<typename PixelType, typename Accumulator>
+class GlobalReduction: public Operation<PixelType>
+{
+private:
+    Accumulator acc;
+public:
+    virtual ~GlobalReduction()
+    {
+    }
+
+    virtual Accumulator initial() = 0;
+    /**
+     * Accumulate @param length pixels, inputs[exp] is a span of exposition exp.
+     */
+    virtual void accumulate(Accumulator & acc, const PixelType * const inputs[], unsigned int exps,
+            size_t length) = 0;
+    virtual void combine(Accumulator & acc, const Accumulator & other) = 0;
+    virtual void finalise(Accumulator & acc)
+    {
+    }
+
+    virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs)
+    {
+        unsigned int noOfExp = inputs.size();
+        int rows = inputs.empty() ? 0 : inputs.front().rows;
+        int bands = parallelBands(rows);
+        std::vector<Accumulator> partial(bands);
+        parallelForRows(bands, [this, &partial, &inputs, noOfExp, rows, bands](const cv::Range & range)
+        {
+            std::vector<const PixelType *> spans(noOfExp);
+            for (int band = range.start; band < range.end; ++band)
+            {
+                partial[band] = initial();
+                for (int row = band * rows / bands; row < (band + 1) * rows / bands; ++row)
+                {
+                    for (unsigned int exp = 0; exp < noOfExp; ++exp)
+                    {
+                        spans[exp] = inputs[exp].ptr<PixelType>(row);
+                    }
+                    accumulate(partial[band], spans.data(), noOfExp, inputs.front().cols);
+                }
+            }
+        });
+
+        acc = initial();
+        std::for_each(partial.begin(), partial.end(), [this](const Accumulator & other)
+        {
+            combine(acc, other);
+        });
+        finalise(acc);
+    }
+
+    const Accumulator & result() const
+    {
+        return acc;
+    }
 };
 
 /**
  * Local operator is processing pixels with use of declared partitions.
  *
  * @method process, @method enterArea and @method leaveArea has to be implemented
- * to use this abstraction.
+ * to use this abstraction. Partitions are processed run by run with @method processSpan.
  *
  * Area with @field ident will be entered only once!
+ *
+ * Mergeable operation {@see isMergeable} is applied in parallel. All areas are entered
+ * first, then chunks of areas are processed concurrently with @method processAreaSpan,
+ * every chunk with its own AreaState. States are merged with @method mergeArea
+ * (in order, one by one) and then area is left.
  */
 template<typename PixelType, typename PartitionType, typename PartitionShift>
 class LocalOperation: public ProcessingOperation<PixelType>
 {
+public:
+    /**
+     * State of a chunk of area processed by one worker.
+     */
+    class AreaState
+    {
+    public:
+        virtual ~AreaState()
+        {
+        }
+    };
+    typedef boost::shared_ptr<AreaState> AreaStatePtr;
+
 private:
     Partition<PixelType, PartitionType, PartitionShift> & partitions;
+
+    void applyMerged(cv::Mat & output, std::vector<cv::Mat> & inputs);
 protected:
     PartitionType size() {
         return partitions.size();
@@ -174,8 +480,134 @@ public:
     virtual void enterArea(unsigned char ident) = 0;
     virtual void leaveArea(unsigned char ident) = 0;
 
+    /**
+     * Override (with @method createAreaState, @method processAreaSpan
+     * and @method mergeArea) to process areas in parallel.
+     */
+    virtual bool isMergeable() const
+    {
+        return false;
+    }
+    /**
+     * New state for a chunk of area @param ident, called concurrently.
+     */
+    virtual AreaStatePtr createAreaState(unsigned char ident)
+    {
+        return AreaStatePtr();
+    }
+    /**
+     * Span of area processed with @param state, called concurrently.
+     */
+    virtual void processAreaSpan(AreaState & state, const PixelType * const inputs[],
+            unsigned int exps, PixelType * output, size_t length)
+    {
+    }
+    /**
+     * Merge @param state of one chunk into area @param ident, called serially.
+     */
+    virtual void mergeArea(unsigned char ident, AreaState & state)
+    {
+    }
+
     virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs);
 };
+/**
+ * Local reduction computes statistics of every area and doesn't write any output.
+ *
+ * Every area starts with @method initial, chunks of areas are accumulated concurrently
+ * (@method accumulate) into own accumulators which are combined (@method combine)
+ * and finalised (@method finalise) when area is left. Results are in @method results.
+ */
+template<typename PixelType, typename PartitionType, typename PartitionShift, typename Accumulator>
+class LocalReduction: public LocalOperation<PixelType, PartitionType, PartitionShift>
+{
+private:
+    typedef LocalOperation<PixelType, PartitionType, PartitionShift> super;
+    typedef typename super::AreaState AreaState;
+    typedef typename super::AreaStatePtr AreaStatePtr;
+
+    struct AccumulatorState: public AreaState
+    {
+        Accumulator acc;
+    };
+
+    std::vector<Accumulator> areas;
+    unsigned char currentArea;
+
+public:
+    LocalReduction(Partition<PixelType, PartitionType, PartitionShift> & partitions)
+            : super(partitions), currentArea(0)
+    {
+    }
+    virtual ~LocalReduction()
+    {
+    }
+
+    virtual Accumulator initial(unsigned char ident) = 0;
+    /**
+     * Accumulate @param length pixels, inputs[exp] is a span of exposition exp.
+     */
+    virtual void accumulate(Accumulator & acc, const PixelType * const inputs[], unsigned int exps,
+            size_t length) = 0;
+    virtual void combine(Accumulator & acc, const Accumulator & other) = 0;
+    virtual void finalise(unsigned char ident, Accumulator & acc)
+    {
+    }
+
+    virtual PixelType process(PixelType inputs[], unsigned int exps)
+    {
+        ExposureArray<const PixelType *, 0> spans(exps);
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            spans[exp] = inputs + exp;
+        }
+        accumulate(areas[currentArea], spans.data(), exps, 1);
+        return inputs[0]; // doesn't matter
+    }
+    virtual void processSpan(const PixelType * const inputs[], unsigned int exps,
+            PixelType * output, size_t length)
+    {
+        accumulate(areas[currentArea], inputs, exps, length);
+    }
+    virtual void enterArea(unsigned char ident)
+    {
+        areas.resize(this->size());
+        areas[ident] = initial(ident);
+        currentArea = ident;
+    }
+    virtual void leaveArea(unsigned char ident)
+    {
+        finalise(ident, areas[ident]);
+    }
+
+    virtual bool isMergeable() const
+    {
+        return true;
+    }
+    virtual AreaStatePtr createAreaState(unsigned char ident)
+    {
+        AccumulatorState * state = new AccumulatorState();
+        state->acc = initial(ident);
+        return AreaStatePtr(state);
+    }
+    virtual void processAreaSpan(AreaState & state, const PixelType * const inputs[],
+            unsigned int exps, PixelType * output, size_t length)
+    {
+        accumulate(static_cast<AccumulatorState &>(state).acc, inputs, exps, length);
+    }
+    virtual void mergeArea(unsigned char ident, AreaState & state)
+    {
+        combine(areas[ident], static_cast<AccumulatorState &>(state).acc);
+    }
+
+    /**
+     * Results of every area, valid after application.
+     */
+    std::vector<Accumulator> & results()
+    {
+        return areas;
+    }
+};
 //*************************************************************************************************
 
 //*************************************************************************************************
@@ -207,6 +639,17 @@ public:
     }
 };
 
+/**
+ * Run of partition pixels in one row, columns [start, start + length) of @field row.
+ */
+template<typename PartitionShift>
+struct PartitionSpan
+{
+    PartitionShift row;
+    PartitionShift start;
+    PartitionShift length;
+};
+
 /**
  * Partition is a image partition creator. This abstraction is
  * required for @see LocalOperation operator.
@@ -214,45 +657,72 @@ public:
 template<typename PixelType, typename PartitionType, typename PartitionShift>
 class Partition: public Preprocess<PixelType>
 {
+public:
+    typedef PartitionSpan<PartitionShift> span_t;
+    typedef std::vector<span_t> spans_t;
+
 protected:
-    // partition -> is vector of jumps in Mat (starting in Mat::begin())
-    // example: for input where { A, B, B, A, B, A, A, A, B, B, B, A }
-    // partition A              { 0,       3,    2, 1, 1,        , 4 }
-    // partition B              {    1, 1,    2,          4, 1, 1    }
-    typedef std::vector<std::pair<PartitionType, std::vector<PartitionShift>>>partition_t;
+    // partition -> is vector of runs (row, first column, length), sorted by position
+    // example: for input where { A, B, B, A, B, A,
+    //                            A, A, B, B, B, A }
+    // partition A              { (0, 0, 1), (0, 3, 1), (0, 5, 1), (1, 0, 2), (1, 5, 1) }
+    // partition B              { (0, 1, 2), (0, 4, 1), (1, 2, 3) }
+    typedef std::vector<std::pair<PartitionType, spans_t>> partition_t;
     partition_t partitions;
 
     PartitionType noOfPartitions = 0;    // btw. index is in range [0, noOfPartitions)
 
+    /**
+     * Add pixel (row, col) to @param spans, pixels has to be added in order.
+     */
+    static void addPixel(spans_t & spans, PartitionShift row, PartitionShift col)
+    {
+        if (!spans.empty() && (spans.back().row == row)
+                && (spans.back().start + spans.back().length == col))
+        {
+            spans.back().length++;
+            return;
+        }
+        span_t span = { row, col, 1 };
+        spans.push_back(span);
+    }
+
 public:
+    /**
+     * Pixel by pixel iterator over partition on given matrix.
+     */
     template<typename AppliedMatPixelType>
     class PartitionIterator : public std::iterator<std::forward_iterator_tag, AppliedMatPixelType>
     {
     private:
-        cv::MatIterator_<AppliedMatPixelType> matIt;
-        typedef typename std::vector<PartitionShift>::const_iterator vecIterator;
+        cv::Mat * m;
+        typedef typename spans_t::const_iterator vecIterator;
         vecIterator partitionIt;
+        PartitionShift col;
     public:
-        PartitionIterator(cv::MatIterator_<AppliedMatPixelType> matIt, vecIterator partitionIt)
-        : matIt(matIt), partitionIt(partitionIt)
+        PartitionIterator(cv::Mat & m, vecIterator partitionIt)
+        : m(&m), partitionIt(partitionIt), col(0)
         {}
         void swap(PartitionIterator& other) noexcept
         {
             using std::swap;
-            swap(matIt, other.matIt);
+            swap(m, other.m);
             swap(partitionIt, other.partitionIt);
+            swap(col, other.col);
         }
         PartitionIterator& operator++ () // Pre-increment
         {
-            matIt += *partitionIt;
-            partitionIt++;
+            if (++col == partitionIt->length)
+            {
+                partitionIt++;
+                col = 0;
+            }
             return *this;
         }
         PartitionIterator operator++ (int) // Post-increment
         {
             PartitionIterator tmp(*this);
-            matIt += *partitionIt;
-            partitionIt++;
+            ++(*this);
             return tmp;
         }
         /** Well, it can work little bit unexpectly,
@@ -262,17 +732,19 @@ public:
         template<class OtherType>
         bool operator == (const PartitionIterator<OtherType>& rhs) const
         {
-            return partitionIt == rhs.partitionIt;
+            return (partitionIt == rhs.partitionIt) && (col == rhs.col);
         }
         template<class OtherType>
         bool operator != (const PartitionIterator<OtherType>& rhs) const
         {
-            return partitionIt != rhs.partitionIt;
+            return !(*this == rhs);
         }
         AppliedMatPixelType& operator* () const
         {
-            return *matIt;
+            return m->ptr<AppliedMatPixelType>(partitionIt->row)[partitionIt->start + col];
         }
+
+        template<class OtherType> friend class PartitionIterator;
     };
 
     virtual ~Partition()
@@ -282,14 +754,35 @@ public:
      */
     virtual void apply(std::vector<cv::Mat> & inputs) = 0;
 
+    /**
+     * Runs of partition @param id.
+     */
+    const spans_t & spans(PartitionType id) const
+    {
+        static const spans_t empty;
+        typedef typename partition_t::const_iterator iterator;
+        iterator it = std::find_if(
+                partitions.begin(), partitions.end(),
+                [&id](const std::pair<PartitionType, spans_t> & p)
+                {
+                    return (id == p.first);
+                });
+        if (it != partitions.end())
+        {
+            return it->second;
+        }
+        debug_print(LVL_ERROR, "Cannot find partition id %d\n", id);
+        return empty;
+    }
+
     template<typename AppliedMatPixelType>
     std::vector<PartitionIterator<AppliedMatPixelType>> listOfBegins(cv::Mat & m)
     {
         std::vector<PartitionIterator<AppliedMatPixelType>> l;
         std::for_each(partitions.begin(), partitions.end(),
-                [&m, &l](std::pair<PartitionType, std::vector<PartitionShift>> & p)
+                [&m, &l](std::pair<PartitionType, spans_t> & p)
                 {
-                    l.push_back(PartitionIterator<AppliedMatPixelType>(m.begin<AppliedMatPixelType>(), p.second.begin()));
+                    l.push_back(PartitionIterator<AppliedMatPixelType>(m, p.second.begin()));
                 });
         return l;
     }
@@ -299,9 +792,9 @@ public:
     {
         std::vector<PartitionIterator<AppliedMatPixelType>> l;
         std::for_each(partitions.begin(), partitions.end(),
-                [&m, &l](std::pair<PartitionType, std::vector<PartitionShift>> & p)
+                [&m, &l](std::pair<PartitionType, spans_t> & p)
                 {
-                    l.push_back(PartitionIterator<AppliedMatPixelType>(m.end<AppliedMatPixelType>(), p.second.end()));
+                    l.push_back(PartitionIterator<AppliedMatPixelType>(m, p.second.end()));
                 });
         return l;
     }
@@ -309,37 +802,13 @@ public:
     template<typename AppliedMatPixelType>
     PartitionIterator<AppliedMatPixelType> begin(cv::Mat & m, PartitionType id)
     {
-        typedef typename partition_t::iterator iterator;
-        iterator it = std::find_if(
-                partitions.begin(), partitions.end(),
-                [&id](std::pair<PartitionType, std::vector<PartitionShift>> & p)
-                {
-                    return (id == p.first);
-                });
-        if (it != partitions.end())
-        {
-            return PartitionIterator<AppliedMatPixelType>(m.begin<AppliedMatPixelType>(), it->second.begin());
-        }
-        debug_print(LVL_ERROR, "Cannot find partition id %d\n", id);
-        return PartitionIterator<AppliedMatPixelType>(m.begin<AppliedMatPixelType>(), std::vector<PartitionShift>().begin());
+        return PartitionIterator<AppliedMatPixelType>(m, spans(id).begin());
     }
 
     template<typename AppliedMatPixelType>
     PartitionIterator<AppliedMatPixelType> end(cv::Mat & m, PartitionType id)
     {
-        typedef typename partition_t::iterator iterator;
-        iterator it = std::find_if(
-                partitions.begin(), partitions.end(),
-                [&id](std::pair<PartitionType, std::vector<PartitionShift>> & p)
-                {
-                    return (id == p.first);
-                });
-        if (it != partitions.end())
-        {
-            return PartitionIterator<AppliedMatPixelType>(m.end<AppliedMatPixelType>(), it->second.end());
-        }
-        debug_print(LVL_ERROR, "Cannot find partition id %d\n", id);
-        return PartitionIterator<AppliedMatPixelType>(m.end<AppliedMatPixelType>(), std::vector<PartitionShift>().end());
+        return PartitionIterator<AppliedMatPixelType>(m, spans(id).end());
     }
 
     PartitionType size()
@@ -349,41 +818,57 @@ public:
 
     size_t size(PartitionType id)
     {
-        typedef typename partition_t::iterator iterator;
-        iterator it = std::find_if(
-                partitions.begin(), partitions.end(),
-                [&id](std::pair<PartitionType, std::vector<PartitionShift>> & p)
-                {
-                    return (id == p.first);
-                });
-        if (it != partitions.end())
+        size_t noOfPixels = 0;
+        const spans_t & s = spans(id);
+        std::for_each(s.begin(), s.end(), [&noOfPixels](const span_t & span)
         {
-            return it->second.size();
-        }
-        debug_print(LVL_DEBUG, "Cannot find id %d\n", id);
-        return 0;
+            noOfPixels += span.length;
+        });
+        return noOfPixels;
     }
 }
 ;
 //*************************************************************************************************
 
 //*************************************************************************************************
+/**
+ * Size of L2 cache (per core) in bytes, or reasonable default if unknown.
+ */
+size_t l2CacheSize();
+
 /**
  * HDRExposition is a base class for HDR processing with Operator(s).
+ *
+ * Consecutive element-wise operations {@see Operation::isElementWise} are
+ * streamed tile by tile, every tile (band of rows) goes through the whole chain
+ * while it is still in cache, tiles are processed concurrently.
+ * Other operations are barriers, they are applied to the whole frame.
  */
 template<typename PixelType>
 class HDRExposition
 {
 private:
+    typedef std::vector<std::reference_wrapper<Operation<PixelType>>> operations_t;
+
     cv::Mat & output;
     std::vector<cv::Mat> inputs;
-    std::vector<std::reference_wrapper<Operation<PixelType>>>operations;
+    operations_t operations;
+
+    size_t tileBytes;
+
+    void streamTiles(typename operations_t::iterator first, typename operations_t::iterator last);
 
 public:
     HDRExposition(cv::Mat& output, std::vector<cv::Mat> inputs);
 
     HDRExposition<PixelType>& addOperation(Operation<PixelType> &);
 
+    /**
+     * Maximal size of one tile (output and all inputs together), l2CacheSize() by default.
+     * 0 disables tile streaming, every operation will sweep the whole frame.
+     */
+    HDRExposition<PixelType>& setTileBytes(size_t tileBytes);
+
     cv::Mat& process();
 };
 
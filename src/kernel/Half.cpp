@@ -0,0 +1,126 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include "Half.hpp"
+
+#include <cassert>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HDR_HALF_F16C 1
+#else
+#define HDR_HALF_F16C 0
+#endif
+
+namespace kernel
+{
+
+#if HDR_HALF_F16C
+
+// Compiled for F16C regardless of the target of the build, used after the check of the CPU.
+__attribute__((target("avx,f16c")))
+static size_t floatToHalfF16C(const float * src, unsigned short * dst, size_t length)
+{
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+static size_t halfToFloatF16C(const unsigned short * src, float * dst, size_t length)
+{
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    return i;
+}
+
+static bool hasF16C()
+{
+    static const bool has = cv::checkHardwareSupport(CV_CPU_AVX)
+            && cv::checkHardwareSupport(CV_CPU_FP16);
+    return has && cv::useOptimized();
+}
+
+#endif // HDR_HALF_F16C
+
+void floatToHalf(const float * src, unsigned short * dst, size_t length)
+{
+    size_t i = 0;
+#if HDR_HALF_F16C
+    if (hasF16C()) i = floatToHalfF16C(src, dst, length);
+#endif
+    for (; i < length; ++i)
+    {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+
+void halfToFloat(const unsigned short * src, float * dst, size_t length)
+{
+    size_t i = 0;
+#if HDR_HALF_F16C
+    if (hasF16C()) i = halfToFloatF16C(src, dst, length);
+#endif
+    for (; i < length; ++i)
+    {
+        dst[i] = halfToFloat(src[i]);
+    }
+}
+
+void convertHalfToFloat(const cv::Mat & src, cv::Mat & dst)
+{
+    assert(src.depth() == CV_16U);
+    dst.create(src.size(), CV_MAKETYPE(CV_32F, src.channels()));
+    const size_t length = (size_t) src.cols * src.channels();
+    for (int row = 0; row < src.rows; ++row)
+    {
+        halfToFloat(src.ptr<unsigned short>(row), dst.ptr<float>(row), length);
+    }
+}
+
+void convertFloatToHalf(const cv::Mat & src, cv::Mat & dst)
+{
+    assert(src.depth() == CV_32F);
+    dst.create(src.size(), CV_MAKETYPE(CV_16U, src.channels()));
+    const size_t length = (size_t) src.cols * src.channels();
+    for (int row = 0; row < src.rows; ++row)
+    {
+        floatToHalf(src.ptr<float>(row), dst.ptr<unsigned short>(row), length);
+    }
+}
+
+} /* namespace kernel */
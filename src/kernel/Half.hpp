@@ -0,0 +1,147 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef HALF_HPP_
+#define HALF_HPP_
+
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+#include <opencv2/opencv.hpp>
+
+namespace kernel
+{
+
+/*
+ * IEEE 754 binary16 (half-float) storage. OpenCV 3 has no 16-bit float depth,
+ * halves are kept as bits in CV_16U matrices and converted to float for arithmetic.
+ * Spans and matrices are converted with F16C instructions when the CPU has them.
+ */
+
+/**
+ * Half nearest to @param value (ties to even), out of range values become infinity.
+ */
+inline unsigned short floatToHalf(float value)
+{
+    unsigned int f;
+    std::memcpy(&f, &value, sizeof(f));
+    const unsigned short sign = (f >> 16) & 0x8000;
+    f &= 0x7fffffff;
+    if (f >= 0x7f800000) // Inf or NaN
+    {
+        return sign | ((f > 0x7f800000) ? 0x7e00 : 0x7c00);
+    }
+    if (f >= 0x477ff000) // rounds above 65504
+    {
+        return sign | 0x7c00;
+    }
+    if (f < 0x38800000) // subnormal half, in units of 2^-24
+    {
+        float magnitude;
+        std::memcpy(&magnitude, &f, sizeof(f));
+        return sign | (unsigned short) std::nearbyint(magnitude * 16777216.f);
+    }
+    // Rebias exponent and round 13 dropped bits to nearest even.
+    f += 0xc8000fff + ((f >> 13) & 1);
+    return sign | (unsigned short) (f >> 13);
+}
+
+/**
+ * Float equal to half @param value.
+ */
+inline float halfToFloat(unsigned short value)
+{
+    const unsigned int sign = (unsigned int) (value & 0x8000) << 16;
+    const unsigned int exponent = (value >> 10) & 0x1f;
+    const unsigned int mantissa = value & 0x3ff;
+    unsigned int f;
+    if (exponent == 0x1f) // Inf or NaN
+    {
+        f = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent == 0) // zero or subnormal
+    {
+        const float magnitude = mantissa * (1.f / 16777216.f);
+        std::memcpy(&f, &magnitude, sizeof(f));
+        f |= sign;
+    }
+    else
+    {
+        f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &f, sizeof(result));
+    return result;
+}
+
+/**
+ * Convert @param length values from @param src to @param dst.
+ */
+void floatToHalf(const float * src, unsigned short * dst, size_t length);
+void halfToFloat(const unsigned short * src, float * dst, size_t length);
+
+/**
+ * Float matrix @param dst of the size and channels of half matrix @param src (CV_16U).
+ */
+void convertHalfToFloat(const cv::Mat & src, cv::Mat & dst);
+
+/**
+ * Half matrix @param dst (CV_16U) of the size and channels of float matrix @param src.
+ */
+void convertFloatToHalf(const cv::Mat & src, cv::Mat & dst);
+
+/*
+ * Pair of halves (a*b* stored at half of the size of cv::Vec2f).
+ * Values are written and read as floats.
+ */
+struct Vec2h
+{
+    typedef float value_type;
+    unsigned short val[2];
+
+    Vec2h()
+    {
+    }
+
+    Vec2h(float a, float b)
+    {
+        val[0] = floatToHalf(a);
+        val[1] = floatToHalf(b);
+    }
+
+    float operator[](int i) const
+    {
+        return halfToFloat(val[i]);
+    }
+};
+
+} /* namespace kernel */
+
+#endif /* HALF_HPP_ */
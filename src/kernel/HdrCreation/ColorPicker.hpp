@@ -0,0 +1,226 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef COLORPICKER_HPP_
+#define COLORPICKER_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <cmath>
+#include <cstddef>
+
+#include "kernel/HDRExposition.hpp"
+#include "kernel/Half.hpp"
+
+// Two channel interleaved loads and stores of universal intrinsics are in OpenCV >= 3.4.
+#if CV_SIMD128 && (CV_VERSION_MAJOR > 3 || CV_VERSION_MINOR >= 4)
+#define HDR_COLOR_PICKER_SIMD 1
+#else
+#define HDR_COLOR_PICKER_SIMD 0
+#endif
+
+namespace HDRCreation
+{
+
+/*
+ * Chromaticity of HDR pixels is taken from the exposition whose luminance is closest
+ * to the middle of the range of PixelType (the best exposed one).
+ * Spans of pixels are processed at once: the index of the best exposition is found
+ * and its a*b* pair gathered with vector selects, 4 (float) or 16 (integer luminance)
+ * pixels per step. Pairs of halves are selected as 32-bit words, without conversion.
+ * Remaining pixels and types without vector kernel use the scalar one.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+struct ColorPicker
+{
+    /**
+     * Exposition from @param inputs (@param exps luminances) closest to the middle
+     * at position @param i. First one wins on ties.
+     */
+    static unsigned int closest(const PixelType * const inputs[], unsigned int exps, size_t i)
+    {
+        const float half = kernel::PixelTraits<PixelType>::unit() / 2;
+        float closestDst = 1e10; // Infty
+        unsigned int closestExpNo = 0;
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            float currentDst = std::abs(inputs[exp][i] - half);
+            if (currentDst < closestDst)
+            {
+                closestDst = currentDst;
+                closestExpNo = exp;
+            }
+        }
+        return closestExpNo;
+    }
+
+    static void pickScalar(const PixelType * const inputs[],
+            const ChromaticityMatType * const chroma[], unsigned int exps,
+            ChromaticityMatType * output, size_t from, size_t length)
+    {
+        for (size_t i = from; i < length; ++i)
+        {
+            output[i] = chroma[closest(inputs, exps, i)][i];
+        }
+    }
+
+    /**
+     * Vector kernel, @return number of pixels done.
+     */
+    static size_t pickVector(const PixelType * const inputs[],
+            const ChromaticityMatType * const chroma[], unsigned int exps,
+            ChromaticityMatType * output, size_t length)
+    {
+        return 0;
+    }
+
+    /**
+     * a*b* of @param length pixels of @param output from @param chroma of the best
+     * exposed of @param exps expositions with luminances @param inputs.
+     * Vector kernel is used unless optimisations are disabled by cv::setUseOptimized.
+     */
+    static void pick(const PixelType * const inputs[],
+            const ChromaticityMatType * const chroma[], unsigned int exps,
+            ChromaticityMatType * output, size_t length)
+    {
+        size_t done = cv::useOptimized() ? pickVector(inputs, chroma, exps, output, length) : 0;
+        pickScalar(inputs, chroma, exps, output, done, length);
+    }
+};
+
+#if HDR_COLOR_PICKER_SIMD
+
+template<>
+inline size_t ColorPicker<float, cv::Vec2f>::pickVector(const float * const inputs[],
+        const cv::Vec2f * const chroma[], unsigned int exps, cv::Vec2f * output,
+        size_t length)
+{
+    const int step = cv::v_float32x4::nlanes;
+    const cv::v_float32x4 half = cv::v_setall_f32(0.5f);
+    size_t i = 0;
+    for (; i + step <= length; i += step)
+    {
+        cv::v_float32x4 closestDst = cv::v_abs(cv::v_load(inputs[0] + i) - half);
+        cv::v_float32x4 a, b;
+        cv::v_load_deinterleave(chroma[0][i].val, a, b);
+        for (unsigned int exp = 1; exp < exps; ++exp)
+        {
+            cv::v_float32x4 currentDst = cv::v_abs(cv::v_load(inputs[exp] + i) - half);
+            cv::v_float32x4 closer = currentDst < closestDst;
+            cv::v_float32x4 expA, expB;
+            cv::v_load_deinterleave(chroma[exp][i].val, expA, expB);
+            closestDst = cv::v_select(closer, currentDst, closestDst);
+            a = cv::v_select(closer, expA, a);
+            b = cv::v_select(closer, expB, b);
+        }
+        cv::v_store_interleave(output[i].val, a, b);
+    }
+    return i;
+}
+
+template<>
+inline size_t ColorPicker<float, kernel::Vec2h>::pickVector(const float * const inputs[],
+        const kernel::Vec2h * const chroma[], unsigned int exps, kernel::Vec2h * output,
+        size_t length)
+{
+    const int step = cv::v_uint32x4::nlanes;
+    const cv::v_float32x4 half = cv::v_setall_f32(0.5f);
+    size_t i = 0;
+    for (; i + step <= length; i += step)
+    {
+        cv::v_float32x4 closestDst = cv::v_abs(cv::v_load(inputs[0] + i) - half);
+        cv::v_uint32x4 ab = cv::v_load(reinterpret_cast<const unsigned *>(chroma[0] + i));
+        for (unsigned int exp = 1; exp < exps; ++exp)
+        {
+            cv::v_float32x4 currentDst = cv::v_abs(cv::v_load(inputs[exp] + i) - half);
+            cv::v_float32x4 closer = currentDst < closestDst;
+            cv::v_uint32x4 expAb = cv::v_load(reinterpret_cast<const unsigned *>(chroma[exp] + i));
+            closestDst = cv::v_select(closer, currentDst, closestDst);
+            ab = cv::v_select(cv::v_reinterpret_as_u32(closer), expAb, ab);
+        }
+        cv::v_store(reinterpret_cast<unsigned *>(output + i), ab);
+    }
+    return i;
+}
+
+/**
+ * |x - unit / 2| for odd unit is (x - (unit + 1) / 2) | ((unit - 1) / 2 - x) + 1/2
+ * with saturated subtractions, the order of distances is kept in 16 bits.
+ */
+inline cv::v_uint16x8 distanceFromHalf(const cv::v_uint16x8 & x, const cv::v_uint16x8 & above,
+        const cv::v_uint16x8 & below)
+{
+    return (x - above) | (below - x);
+}
+
+template<>
+inline size_t ColorPicker<unsigned short, cv::Vec2b>::pickVector(
+        const unsigned short * const inputs[], const cv::Vec2b * const chroma[],
+        unsigned int exps, cv::Vec2b * output, size_t length)
+{
+    const int step = cv::v_uint8x16::nlanes;
+    const int halfStep = cv::v_uint16x8::nlanes;
+    const unsigned short unit = kernel::PixelTraits<unsigned short>::unit();
+    const cv::v_uint16x8 above = cv::v_setall_u16((unit + 1) / 2);
+    const cv::v_uint16x8 below = cv::v_setall_u16(unit / 2);
+    size_t i = 0;
+    for (; i + step <= length; i += step)
+    {
+        cv::v_uint16x8 closestLo = distanceFromHalf(cv::v_load(inputs[0] + i), above, below);
+        cv::v_uint16x8 closestHi = distanceFromHalf(cv::v_load(inputs[0] + i + halfStep),
+                above, below);
+        cv::v_uint8x16 a, b;
+        cv::v_load_deinterleave(chroma[0][i].val, a, b);
+        for (unsigned int exp = 1; exp < exps; ++exp)
+        {
+            cv::v_uint16x8 currentLo = distanceFromHalf(cv::v_load(inputs[exp] + i), above,
+                    below);
+            cv::v_uint16x8 currentHi = distanceFromHalf(cv::v_load(inputs[exp] + i + halfStep),
+                    above, below);
+            cv::v_uint16x8 closerLo = currentLo < closestLo;
+            cv::v_uint16x8 closerHi = currentHi < closestHi;
+            // Masks of 0xffff are saturated to 0xff.
+            cv::v_uint8x16 closer = cv::v_pack(closerLo, closerHi);
+            cv::v_uint8x16 expA, expB;
+            cv::v_load_deinterleave(chroma[exp][i].val, expA, expB);
+            closestLo = cv::v_select(closerLo, currentLo, closestLo);
+            closestHi = cv::v_select(closerHi, currentHi, closestHi);
+            a = cv::v_select(closer, expA, a);
+            b = cv::v_select(closer, expB, b);
+        }
+        cv::v_store_interleave(output[i].val, a, b);
+    }
+    return i;
+}
+
+#endif // HDR_COLOR_PICKER_SIMD
+
+} /* namespace HDRCreation */
+
+#endif /* COLORPICKER_HPP_ */
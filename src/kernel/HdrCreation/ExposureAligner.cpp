@@ -0,0 +1,312 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include "ExposureAligner.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "kernel/WorkerPool.hpp"
+
+namespace HDRCreation
+{
+
+using namespace std;
+using namespace cv;
+
+ExposureAligner::ExposureAligner(const GlobalArgs_t & globalArgs)
+        : globalArgs(globalArgs)
+{
+}
+
+/**
+ * 8-bit luminance of frame, only the order of values matters.
+ */
+Mat ExposureAligner::grayOf(kernel::GenericFrame & frame)
+{
+    const Mat & raw = frame.getRawFrame();
+    Mat gray;
+    double unit = 1;
+    if (raw.channels() == 1)
+    {
+        gray = raw;
+    }
+    else
+    {
+        switch (frame.getColorSpace())
+        {
+            case kernel::GenericFrame::COLOR_BGR:
+                cvtColor(raw, gray, COLOR_BGR2GRAY);
+            break;
+            case kernel::GenericFrame::COLOR_RGB:
+                cvtColor(raw, gray, COLOR_RGB2GRAY);
+            break;
+            case kernel::GenericFrame::COLOR_CIELab:
+                extractChannel(raw, gray, 0);
+                unit = 100; // float L
+            break;
+            default:
+                extractChannel(raw, gray, 1); // Y of XYZ
+        }
+    }
+    switch (gray.depth())
+    {
+        case CV_8U:
+            return gray;
+        case CV_16U:
+            unit = 65535;
+        break;
+    }
+    Mat gray8;
+    gray.convertTo(gray8, CV_8U, 255. / unit);
+    return gray8;
+}
+
+int ExposureAligner::levelsFor(const Size & size)
+{
+    int levels = 1;
+    while ((levels < maxLevels) && ((std::min(size.width, size.height) >> levels) >= 32))
+    {
+        ++levels;
+    }
+    return levels;
+}
+
+/**
+ * Median of 8-bit @param gray from its histogram.
+ */
+static int medianOf(const Mat & gray)
+{
+    vector<size_t> histogram(256, 0);
+    for (int row = 0; row < gray.rows; ++row)
+    {
+        const unsigned char * g = gray.ptr<unsigned char>(row);
+        for (int col = 0; col < gray.cols; ++col)
+        {
+            ++histogram[g[col]];
+        }
+    }
+    const size_t half = gray.total() / 2;
+    size_t count = 0;
+    for (int value = 0; value < 256; ++value)
+    {
+        count += histogram[value];
+        if (count > half) return value;
+    }
+    return 255;
+}
+
+ExposureAligner::Pyramid ExposureAligner::pyramidOf(const Mat & gray, int levels)
+{
+    vector<Mat> grays(levels);
+    grays[0] = gray;
+    for (int level = 1; level < levels; ++level)
+    {
+        const Mat & finer = grays[level - 1];
+        resize(finer, grays[level], Size(finer.cols / 2, finer.rows / 2), 0, 0, INTER_AREA);
+    }
+
+    Pyramid pyramid;
+    pyramid.thresholds.resize(levels);
+    pyramid.exclusions.resize(levels);
+    kernel::WorkerPool & workers = kernel::WorkerPool::shared();
+    kernel::WorkerPool::Group bitmaps;
+    for (int level = 0; level < levels; ++level)
+    {
+        workers.submit(bitmaps, [&grays, &pyramid, level]()
+        {
+            const Mat & g = grays[level];
+            const int median = medianOf(g);
+            Mat distance;
+            compare(g, median, pyramid.thresholds[level], CMP_GT);
+            absdiff(g, Scalar::all(median), distance);
+            compare(distance, exclusionTolerance, pyramid.exclusions[level], CMP_GT);
+        });
+    }
+    workers.wait(bitmaps);
+    return pyramid;
+}
+
+/**
+ * Fraction of differing pixels of bitmaps at @param level in @param region of the reference,
+ * moving bitmaps are read at @param shift. Only pixels of both frames count.
+ */
+double ExposureAligner::differenceOf(const Pyramid & reference, const Pyramid & moving,
+        int level, const Rect & region, const Point & shift, Mat & buffer)
+{
+    const Mat & referenceBits = reference.thresholds[level];
+    const Mat & movingBits = moving.thresholds[level];
+    const Rect area = region & Rect(0, 0, referenceBits.cols, referenceBits.rows)
+            & Rect(-shift.x, -shift.y, movingBits.cols, movingBits.rows);
+    if (area.area() == 0) return 1;
+    const Rect movedArea = area + shift;
+
+    bitwise_xor(referenceBits(area), movingBits(movedArea), buffer);
+    bitwise_and(buffer, reference.exclusions[level](area), buffer);
+    bitwise_and(buffer, moving.exclusions[level](movedArea), buffer);
+    return countNonZero(buffer) / (double) area.area();
+}
+
+Point ExposureAligner::shiftOf(const Pyramid & reference, const Pyramid & moving,
+        const Rect & region)
+{
+    assert(reference.thresholds.size() == moving.thresholds.size());
+    const int levels = reference.thresholds.size();
+    Point shift(0, 0);
+    Mat buffer;
+    for (int level = levels - 1; level >= 0; --level)
+    {
+        shift *= 2;
+        const Rect levelRegion(region.x >> level, region.y >> level, region.width >> level,
+                region.height >> level);
+        // Current shift wins on ties.
+        Point best = shift;
+        double bestDifference = differenceOf(reference, moving, level, levelRegion, shift,
+                buffer);
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                if ((dx == 0) && (dy == 0)) continue;
+                const Point candidate = shift + Point(dx, dy);
+                const double difference = differenceOf(reference, moving, level, levelRegion,
+                        candidate, buffer);
+                if (difference < bestDifference)
+                {
+                    bestDifference = difference;
+                    best = candidate;
+                }
+            }
+        }
+        shift = best;
+    }
+    return shift;
+}
+
+ExposureAligner::Transform ExposureAligner::transformOf(const Pyramid & reference,
+        const Pyramid & moving, const Size & size, bool rotation)
+{
+    Transform transform;
+    transform.angle = 0;
+    if (!rotation)
+    {
+        transform.shift = shiftOf(reference, moving, Rect(Point(0, 0), size));
+        return transform;
+    }
+    // Centres of halves are half of the width apart, rotation moves them vertically
+    // in opposite directions.
+    const int half = size.width / 2;
+    const Point left = shiftOf(reference, moving, Rect(0, 0, half, size.height));
+    const Point right = shiftOf(reference, moving, Rect(half, 0, size.width - half, size.height));
+    transform.angle = std::atan2(double(right.y - left.y), double(half));
+    transform.shift = Point2f((left.x + right.x) * 0.5f, (left.y + right.y) * 0.5f);
+    return transform;
+}
+
+bool ExposureAligner::apply(kernel::GenericFrame & frame, const Transform & transform)
+{
+    if ((transform.angle == 0) && (transform.shift == Point2f(0, 0))) return true;
+    const Mat & raw = frame.getRawFrame();
+    const double c = std::cos(transform.angle), s = std::sin(transform.angle);
+    const double centreX = raw.cols * 0.5, centreY = raw.rows * 0.5;
+    // Maps pixels of the output to pixels of the frame.
+    Mat map(2, 3, CV_64F);
+    map.at<double>(0, 0) = c;
+    map.at<double>(0, 1) = -s;
+    map.at<double>(0, 2) = centreX + transform.shift.x - (c * centreX - s * centreY);
+    map.at<double>(1, 0) = s;
+    map.at<double>(1, 1) = c;
+    map.at<double>(1, 2) = centreY + transform.shift.y - (s * centreX + c * centreY);
+    const bool wholePixels = (transform.angle == 0)
+            && (transform.shift.x == std::floor(transform.shift.x))
+            && (transform.shift.y == std::floor(transform.shift.y));
+    Mat aligned;
+    warpAffine(raw, aligned, map, raw.size(),
+            (wholePixels ? INTER_NEAREST : INTER_LINEAR) | WARP_INVERSE_MAP, BORDER_REPLICATE);
+    return frame.assignFrameTo(aligned, frame.getColorSpace());
+}
+
+bool ExposureAligner::align(vector<kernel::GenericFramePtr> & frames)
+{
+    const unsigned int exps = frames.size();
+    if (exps < 2) return true;
+    const Size size = frames.front()->getRawFrame().size();
+    for (unsigned int exp = 0; exp < exps; ++exp)
+    {
+        if (!frames[exp]->isValid() || (frames[exp]->getRawFrame().size() != size))
+        {
+            verbose_print(globalArgs.verbosity, "Exposition %u can't be aligned.", exp);
+            return false;
+        }
+    }
+    const int levels = levelsFor(size);
+    const unsigned int reference = exps / 2;
+    const bool rotation = globalArgs.align > 1;
+
+    kernel::WorkerPool & workers = kernel::WorkerPool::shared();
+    vector<Pyramid> pyramids(exps);
+    kernel::WorkerPool::Group building;
+    for (unsigned int exp = 0; exp < exps; ++exp)
+    {
+        workers.submit(building, [&frames, &pyramids, exp, levels]()
+        {
+            pyramids[exp] = pyramidOf(grayOf(*frames[exp]), levels);
+        });
+    }
+    workers.wait(building);
+
+    vector<Transform> transforms(exps);
+    vector<char> applied(exps, true);
+    kernel::WorkerPool::Group aligning;
+    for (unsigned int exp = 0; exp < exps; ++exp)
+    {
+        transforms[exp].angle = 0;
+        if (exp == reference) continue;
+        workers.submit(aligning, [&frames, &pyramids, &transforms, &applied, exp, reference, size, rotation]()
+        {
+            transforms[exp] = transformOf(pyramids[reference], pyramids[exp], size, rotation);
+            applied[exp] = apply(*frames[exp], transforms[exp]);
+        });
+    }
+    workers.wait(aligning);
+
+    bool aligned = true;
+    for (unsigned int exp = 0; exp < exps; ++exp)
+    {
+        verbose_print(globalArgs.verbosity, "Exposition %u shifted by (%.1f, %.1f), rotated by %.3f deg.",
+                exp, transforms[exp].shift.x, transforms[exp].shift.y,
+                transforms[exp].angle * 180 / CV_PI);
+        aligned &= (applied[exp] != 0);
+    }
+    return aligned;
+}
+
+} /* namespace HDRCreation */
@@ -0,0 +1,125 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef EXPOSUREALIGNER_HPP_
+#define EXPOSUREALIGNER_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "config.h"
+#include "kernel/GenericFrame.hpp"
+
+namespace HDRCreation
+{
+
+/*
+ * Alignment of expositions by median threshold bitmaps (Ward, 2003).
+ * Pixels above the median of an exposition are set in its threshold bitmap, pixels
+ * close to the median are excluded from comparison. Bitmaps don't depend on exposure,
+ * shifts are found on a pyramid of them: from the coarsest level the shift is doubled
+ * and refined by one pixel, by the count of differing pixels of 9 candidates.
+ * Expositions are aligned in place to the middle one, decoded frames are used,
+ * expositions and levels of pyramids are processed in parallel.
+ * Small rotation is estimated from shifts of left and right halves of frames.
+ */
+class ExposureAligner
+{
+public:
+    /*
+     * Moving frame sampled at R(angle) * (p - c) + c + shift matches reference at p,
+     * c is the centre of frames.
+     */
+    struct Transform
+    {
+        cv::Point2f shift;
+        double angle; // radians
+    };
+
+    /*
+     * Threshold and exclusion bitmaps (0 or 255) of all levels, the finest first.
+     */
+    struct Pyramid
+    {
+        std::vector<cv::Mat> thresholds;
+        std::vector<cv::Mat> exclusions;
+    };
+
+    // Shifts up to 2^maxLevels - 1 pixels are found.
+    static const int maxLevels = 6;
+    // Pixels within the tolerance from the median are excluded.
+    static const int exclusionTolerance = 4;
+
+private:
+    const GlobalArgs_t & globalArgs;
+
+    static cv::Mat grayOf(kernel::GenericFrame & frame);
+    static double differenceOf(const Pyramid & reference, const Pyramid & moving, int level,
+            const cv::Rect & region, const cv::Point & shift, cv::Mat & buffer);
+    static bool apply(kernel::GenericFrame & frame, const Transform & transform);
+
+public:
+    explicit ExposureAligner(const GlobalArgs_t & globalArgs);
+
+    /**
+     * Align @param frames (decoded, of one size) to the middle one, with rotation
+     * if globalArgs.align asks for it.
+     */
+    bool align(std::vector<kernel::GenericFramePtr> & frames);
+
+    /**
+     * Levels of pyramids for frames of @param size, the coarsest one isn't smaller
+     * than 32 pixels.
+     */
+    static int levelsFor(const cv::Size & size);
+
+    /**
+     * Bitmaps of 8-bit @param gray on @param levels levels, bitmaps of levels are
+     * built concurrently.
+     */
+    static Pyramid pyramidOf(const cv::Mat & gray, int levels);
+
+    /**
+     * Shift (in pixels of the finest level) of @param moving against @param reference
+     * in @param region of the finest level.
+     */
+    static cv::Point shiftOf(const Pyramid & reference, const Pyramid & moving,
+            const cv::Rect & region);
+
+    /**
+     * Transform of @param moving against @param reference of frames of @param size,
+     * with @param rotation the angle is estimated as well.
+     */
+    static Transform transformOf(const Pyramid & reference, const Pyramid & moving,
+            const cv::Size & size, bool rotation);
+};
+
+} /* namespace HDRCreation */
+
+#endif /* EXPOSUREALIGNER_HPP_ */
@@ -29,13 +29,17 @@
  */
 #include "HDRCreator.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <chrono>
 #include <vector>
 #include <cmath>
-
-#include <boost/thread.hpp>
+#include <sstream>
 
 #include "kernel/HDRExposition.hpp"
+#include "kernel/Half.hpp"
+#include "kernel/TaskGraph.hpp"
+#include "ColorPicker.hpp"
 #include "LuminanceProcessor.hpp"
 
 namespace HDRCreation
@@ -49,6 +53,11 @@ HDRCreator::HDRCreator(const GlobalArgs_t & globalArgs)
 {
 }
 
+kernel::BufferPool & HDRCreator::getBufferPool()
+{
+    return pool;
+}
+
 inline void getSize(Mat& m, unsigned int & w, unsigned int & h)
 {
     Size s = m.size();
@@ -56,223 +65,821 @@ inline void getSize(Mat& m, unsigned int & w, unsigned int & h)
     h = s.height;
 }
 
+/*
+ * Storage of a*b* pairs: Lab is decoded in lab_type of depth labDepth, a*b* planes
+ * are matrices of type and are blurred as blur_type.
+ */
 template<typename ChromaticityMatType>
-class ChooseClosestColor: public kernel::GlobalOperation<float>
+struct ChromaTraits
 {
-private:
-    vector<kernel::GenericFramePtr> & originalInputs;
+    typedef typename ChromaticityMatType::value_type lab_type;
+    typedef ChromaticityMatType blur_type;
+    static const bool half = false;
+    enum
+    {
+        labDepth = DataType<ChromaticityMatType>::depth, type = DataType<ChromaticityMatType>::type
+    };
+};
 
-    Mat & outputColor;
+/*
+ * Half-float a*b* are decoded from float Lab and widened to float for the blur.
+ */
+template<>
+struct ChromaTraits<kernel::Vec2h>
+{
+    typedef float lab_type;
+    typedef Vec2f blur_type;
+    static const bool half = true;
+    enum
+    {
+        labDepth = CV_32F, type = CV_16UC2
+    };
+};
 
-    Mat & hdrLuminance;
-    vector<Mat> & inputsCH;
+/*
+ * Rows of L planes of PixelType, stored in matrices of type. Rows are written
+ * to @method writable and then to @method store, read by @method load.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+struct LuminanceRows
+{
+    enum
+    {
+        type = kernel::PixelTraits<PixelType>::depth
+    };
 
-    MatIterator_<float> hdrIt;
-    vector<MatIterator_<ChromaticityMatType>> inputsCHIt;
-    MatIterator_<ChromaticityMatType> outputIt;
+    static PixelType * writable(Mat & L, int row, vector<PixelType> & buffer)
+    {
+        return L.ptr<PixelType>(row);
+    }
 
-public:
-#ifndef NDEBUG
-    vector<unsigned long int> pixFromExp;
-#endif
+    static void store(Mat & L, int row, const PixelType * values)
+    {
+    }
 
-    explicit ChooseClosestColor(vector<kernel::GenericFramePtr> & originalInputs,
-            Mat & hdrLuminance, vector<Mat> & inputsCH, Mat & outputColor)
-            : originalInputs(originalInputs), outputColor(outputColor), hdrLuminance(hdrLuminance), inputsCH(
-                    inputsCH)
+    static const PixelType * load(const Mat & L, int row, vector<PixelType> & buffer)
     {
-        debug_print(LVL_DEBUG, "Creating color picker for hdr mat %p.\n", (void* ) &hdrLuminance);
+        return L.ptr<PixelType>(row);
     }
+};
 
-    virtual float process(float inputs[], unsigned int exps)
+/*
+ * With half-float a*b* whole L planes are half-floats too (CV_16U), rows are widened
+ * to float in a buffer and narrowed when stored. Float planes (strips) are used as they are.
+ */
+template<>
+struct LuminanceRows<float, kernel::Vec2h>
+{
+    enum
     {
-        float closestDst = 1e10; // Infty
-        unsigned int closestExpNo = 0;
-        float hdrValue = *hdrIt; // assumption that sizes are proper
-        for (int i = 0; i < exps; ++i)
+        type = CV_16U
+    };
+
+    static float * writable(Mat & L, int row, vector<float> & buffer)
+    {
+        if (L.depth() == CV_32F) return L.ptr<float>(row);
+        buffer.resize(L.cols);
+        return buffer.data();
+    }
+
+    static void store(Mat & L, int row, const float * values)
+    {
+        if (L.depth() == CV_16U) kernel::floatToHalf(values, L.ptr<unsigned short>(row), L.cols);
+    }
+
+    static const float * load(const Mat & L, int row, vector<float> & buffer)
+    {
+        if (L.depth() == CV_32F) return L.ptr<float>(row);
+        buffer.resize(L.cols);
+        kernel::halfToFloat(L.ptr<unsigned short>(row), buffer.data(), L.cols);
+        return buffer.data();
+    }
+};
+
+/**
+ * Luminances of expositions @param inputsL for @param row of chromaticity of @param cols
+ * pixels. Chromaticity at half resolution gets means of 2x2 blocks. Rows are kept
+ * in @param buffers, three for every exposition (luminances, widened top and bottom row).
+ */
+template<typename PixelType, typename ChromaticityMatType>
+void chromaRowLuminances(const vector<Mat> & inputsL, int row, int cols,
+        vector<vector<PixelType>> & buffers, vector<const PixelType *> & luminances)
+{
+    typedef LuminanceRows<PixelType, ChromaticityMatType> rows_t;
+    for (unsigned int exp = 0; exp < inputsL.size(); ++exp)
+    {
+        const Mat & L = inputsL[exp];
+        vector<PixelType> & means = buffers[3 * exp];
+        if (cols == L.cols)
         {
-//            float ev = originalInputs[i]->getEV().get();
-            float currentDst = abs(inputs[i] - 0.5 /*hdrValue*/);
-            if (currentDst < closestDst)
+            luminances[exp] = rows_t::load(L, row, means);
+            continue;
+        }
+        means.resize(cols);
+        const PixelType * top = rows_t::load(L, 2 * row, buffers[3 * exp + 1]);
+        const PixelType * bottom = rows_t::load(L, std::min(2 * row + 1, L.rows - 1),
+                buffers[3 * exp + 2]);
+        for (int col = 0; col < cols; ++col)
+        {
+            const int left = 2 * col, right = std::min(2 * col + 1, L.cols - 1);
+            means[col] = saturate_cast<PixelType>(
+                    (float(top[left]) + top[right] + bottom[left] + bottom[right]) * 0.25f);
+        }
+        luminances[exp] = means.data();
+    }
+}
+
+/**
+ * a*b* of @param output picked from @param inputsCH of the best exposed of expositions
+ * with luminances @param inputsL, in bands of rows on the shared worker pool.
+ * Chromaticity may be at half resolution of luminance.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+bool extractColor(Mat & output, vector<Mat> & inputsL, vector<Mat> & inputsCH)
+{
+    typedef ColorPicker<PixelType, ChromaticityMatType> picker_t;
+    const unsigned int exps = inputsL.size();
+    kernel::parallelForRows(output.rows, [&output, &inputsL, &inputsCH, exps](const Range & range)
+    {
+        vector<vector<PixelType>> buffers(3 * exps);
+        vector<const PixelType *> luminances(exps);
+        vector<const ChromaticityMatType *> chroma(exps);
+        for (int row = range.start; row < range.end; ++row)
+        {
+            chromaRowLuminances<PixelType, ChromaticityMatType>(inputsL, row, output.cols, buffers,
+                    luminances);
+            for (unsigned int exp = 0; exp < exps; ++exp)
             {
-                closestDst = currentDst;
-                closestExpNo = i;
+                chroma[exp] = inputsCH[exp].ptr<ChromaticityMatType>(row);
             }
+            picker_t::pick(luminances.data(), chroma.data(), exps,
+                    output.ptr<ChromaticityMatType>(row), output.cols);
         }
-        // Get color from exposition closestExpNo
+    });
 #ifndef NDEBUG
-        pixFromExp[closestExpNo]++;
+    vector<unsigned long int> pixFromExp(exps, 0);
+    vector<vector<PixelType>> buffers(3 * exps);
+    vector<const PixelType *> luminances(exps);
+    for (int row = 0; row < output.rows; ++row)
+    {
+        chromaRowLuminances<PixelType, ChromaticityMatType>(inputsL, row, output.cols, buffers,
+                luminances);
+        for (int col = 0; col < output.cols; ++col)
+            pixFromExp[picker_t::closest(luminances.data(), exps, col)]++;
+    }
+    for (unsigned int i = 0; i < exps; ++i)
+    {
+        debug_print(LVL_DEBUG, "Color pixels picked from exp %d == %lu\n", i, pixFromExp[i]);
+    }
 #endif
-        *outputIt = *(inputsCHIt[closestExpNo]);
-        // Move
-        hdrIt++;
-        outputIt++;
-        for_each(inputsCHIt.begin(), inputsCHIt.end(), [](MatIterator_<ChromaticityMatType>& it)
-        {   it++;});
-        return hdrValue; // Should do nothing if output is HDR Image
+    return true;
+}
+
+/**
+ * Maximal value of pixels of @param depth.
+ */
+inline double depthUnit(int depth)
+{
+    switch (depth)
+    {
+        case CV_8U:
+            return kernel::PixelTraits<unsigned char>::unit();
+        case CV_16U:
+            return kernel::PixelTraits<unsigned short>::unit();
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Write L of Lab pixels scaled by @param lScale to @param L and a*b* to @param ab.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+void splitLab(const Mat & lab, Mat L, Mat ab, double lScale)
+{
+    typedef typename ChromaTraits<ChromaticityMatType>::lab_type LabType;
+    typedef LuminanceRows<PixelType, ChromaticityMatType> rows_t;
+    vector<PixelType> buffer;
+    for (int row = 0; row < lab.rows; ++row)
+    {
+        const LabType * src = lab.ptr<LabType>(row);
+        PixelType * l = rows_t::writable(L, row, buffer);
+        ChromaticityMatType * c = ab.ptr<ChromaticityMatType>(row);
+        for (int col = 0; col < lab.cols; ++col, src += 3)
+        {
+            l[col] = saturate_cast<PixelType>(src[0] * lScale);
+            c[col] = ChromaticityMatType(src[1], src[2]);
+        }
+        rows_t::store(L, row, l);
     }
+}
+
+/**
+ * Write L of Lab pixels scaled by @param lScale to @param L and means of 2x2 blocks
+ * of a*b* to @param ab (half resolution, @param lab starts on an even row).
+ */
+template<typename PixelType, typename ChromaticityMatType>
+void splitLabHalfChroma(const Mat & lab, Mat L, Mat ab, double lScale)
+{
+    typedef typename ChromaTraits<ChromaticityMatType>::lab_type LabType;
+    typedef LuminanceRows<PixelType, ChromaticityMatType> rows_t;
+    vector<PixelType> buffer;
+    for (int row = 0; row < lab.rows; ++row)
+    {
+        const LabType * src = lab.ptr<LabType>(row);
+        PixelType * l = rows_t::writable(L, row, buffer);
+        for (int col = 0; col < lab.cols; ++col, src += 3)
+        {
+            l[col] = saturate_cast<PixelType>(src[0] * lScale);
+        }
+        rows_t::store(L, row, l);
+    }
+    for (int row = 0; row < ab.rows; ++row)
+    {
+        const LabType * top = lab.ptr<LabType>(2 * row);
+        const LabType * bottom = lab.ptr<LabType>(std::min(2 * row + 1, lab.rows - 1));
+        ChromaticityMatType * c = ab.ptr<ChromaticityMatType>(row);
+        for (int col = 0; col < ab.cols; ++col)
+        {
+            const int left = 6 * col, right = 3 * std::min(2 * col + 1, lab.cols - 1);
+            c[col] = ChromaticityMatType(
+                    saturate_cast<LabType>((float(top[left + 1]) + top[right + 1]
+                            + bottom[left + 1] + bottom[right + 1]) * 0.25f),
+                    saturate_cast<LabType>((float(top[left + 2]) + top[right + 2]
+                            + bottom[left + 2] + bottom[right + 2]) * 0.25f));
+        }
+    }
+}
+
+/**
+ * L and a*b* of one exposition, frame is read once. Depth and colorspace are converted
+ * in strips of rows which fit in cache, L (scaled by @param lScale) and a*b* are written
+ * straight to @param L and @param ab. a*b* is at half resolution if @param ab is smaller.
+ * Only @param frameRows of the frame are decoded, the whole frame by default.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+bool decodeLab(kernel::GenericFrame & gF, Mat & L, Mat & ab, double lScale,
+        const Range & frameRows = Range::all())
+{
+    const int labDepth = ChromaTraits<ChromaticityMatType>::labDepth;
+    Mat & wholeFrame = gF.getRawFrame();
+    int code = -1;
+    switch (gF.getColorSpace())
+    {
+        case kernel::GenericFrame::COLOR_BGR:
+            code = COLOR_BGR2Lab;
+        break;
+        case kernel::GenericFrame::COLOR_RGB:
+            code = COLOR_RGB2Lab;
+        break;
+        case kernel::GenericFrame::COLOR_CIELab:
+            if (!gF.convertToDepth(CV_MAKETYPE(labDepth, 3))) return false;
+        break;
+        default:
+            // Other colorspaces are converted as a whole.
+            if (!gF.convertToDepth(CV_MAKETYPE(labDepth, 3))) return false;
+            if (!gF.convertToColorSpace(kernel::GenericFrame::COLOR_CIELab)) return false;
+    }
+    if (wholeFrame.channels() != 3) return false;
+    const Mat frame = wholeFrame.rowRange(frameRows);
+
+    const double depthScale = depthUnit(labDepth) / depthUnit(frame.depth());
+    const size_t rowBytes = frame.cols * 3 * sizeof(float) * 2; // converted and Lab
+    const bool halfChroma = ab.rows < frame.rows;
+    int stripRows = std::max<int>(1, kernel::l2CacheSize() / rowBytes);
+    if (halfChroma) stripRows = (stripRows + 1) & ~1; // strips of pairs of rows
+    const int strips = (frame.rows + stripRows - 1) / stripRows;
+    kernel::parallelForRows(strips,
+            [&frame, &L, &ab, code, labDepth, depthScale, stripRows, lScale, halfChroma](const Range & range)
+            {
+                Mat converted, lab;
+                for (int strip = range.start; strip < range.end; ++strip)
+                {
+                    Range rows(strip * stripRows, std::min((strip + 1) * stripRows, frame.rows));
+                    Mat src = frame.rowRange(rows);
+                    if (code >= 0)
+                    {
+                        if (src.depth() != labDepth)
+                        {
+                            src.convertTo(converted, CV_MAKETYPE(labDepth, 3), depthScale);
+                            src = converted;
+                        }
+                        cvtColor(src, lab, code);
+                        src = lab;
+                    }
+                    if (halfChroma)
+                    {
+                        splitLabHalfChroma<PixelType, ChromaticityMatType>(src, L.rowRange(rows),
+                                ab.rowRange(rows.start / 2, (rows.end + 1) / 2), lScale);
+                    }
+                    else
+                    {
+                        splitLab<PixelType, ChromaticityMatType>(src, L.rowRange(rows), ab.rowRange(rows), lScale);
+                    }
+                }
+            });
+    return true;
+}
+
+/**
+ * Interleaved Lab @param output in one sweep: L scaled from [@param minL, @param maxL]
+ * to [0, 100], a*b* blurred and moved by @param abShift. Blur of a strip reads
+ * neighbouring rows of the whole plane, strips give the same result as the whole frame.
+ * a*b* at half resolution is upsampled bilinearly (pixel centres aligned), weights
+ * of neighbours are 3/4 and 1/4 in each dimension.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+void assembleLab(const Mat & L, double minL, double maxL, const Mat & ab, double abShift,
+        Mat & output)
+{
+    const float minValue = minL;
+    const float scale = (maxL > minL) ? 100. / (maxL - minL) : 0;
+    const float shift = abShift;
+    const bool halfChroma = ab.rows < L.rows;
+    const size_t rowBytes = L.cols * (sizeof(PixelType) + 2 * ab.elemSize() + output.elemSize());
+    const int stripRows = std::max<int>(1, kernel::l2CacheSize() / rowBytes);
+    const int strips = (L.rows + stripRows - 1) / stripRows;
+    kernel::parallelForRows(strips,
+            [&L, &ab, &output, minValue, scale, shift, stripRows, halfChroma](const Range & range)
+            {
+                typedef typename ChromaTraits<ChromaticityMatType>::blur_type BlurType;
+                typedef LuminanceRows<PixelType, ChromaticityMatType> rows_t;
+                Mat widened, blurred;
+                vector<PixelType> buffer;
+                for (int strip = range.start; strip < range.end; ++strip)
+                {
+                    Range rows(strip * stripRows, std::min((strip + 1) * stripRows, L.rows));
+                    Range abRows = !halfChroma ? rows : Range(std::max(rows.start / 2 - 1, 0),
+                            std::min((rows.end - 1) / 2 + 2, ab.rows));
+                    Mat abStrip = ab.rowRange(abRows);
+                    if (ChromaTraits<ChromaticityMatType>::half)
+                    {
+                        // Rows of the plane next to the strip are widened too, they are
+                        // read by the blur, then dropped.
+                        Size wholeSize;
+                        Point offset;
+                        abStrip.locateROI(wholeSize, offset);
+                        const int above = std::min(offset.y, 1);
+                        const int below = std::min(wholeSize.height - offset.y - abStrip.rows, 1);
+                        abStrip.adjustROI(above, below, 0, 0);
+                        kernel::convertHalfToFloat(abStrip, widened);
+                        GaussianBlur(widened, blurred, Size(3, 3), 1.5, 1.5);
+                        blurred = blurred.rowRange(above, blurred.rows - below);
+                    }
+                    else
+                    {
+                        GaussianBlur(abStrip, blurred, Size(3, 3), 1.5, 1.5);
+                    }
+                    for (int row = rows.start; row < rows.end; ++row)
+                    {
+                        const PixelType * l = rows_t::load(L, row, buffer);
+                        float * out = output.ptr<float>(row);
+                        if (!halfChroma)
+                        {
+                            const BlurType * c = blurred.ptr<BlurType>(row - abRows.start);
+                            for (int col = 0; col < L.cols; ++col, out += 3)
+                            {
+                                out[0] = (l[col] - minValue) * scale;
+                                out[1] = c[col][0] + shift;
+                                out[2] = c[col][1] + shift;
+                            }
+                            continue;
+                        }
+                        const int nearRow = row / 2;
+                        const int farRow = (row & 1) ? std::min(nearRow + 1, ab.rows - 1)
+                                : std::max(nearRow - 1, 0);
+                        const BlurType * cNear = blurred.ptr<BlurType>(nearRow - abRows.start);
+                        const BlurType * cFar = blurred.ptr<BlurType>(farRow - abRows.start);
+                        for (int col = 0; col < L.cols; ++col, out += 3)
+                        {
+                            const int nearCol = col / 2;
+                            const int farCol = (col & 1) ? std::min(nearCol + 1, ab.cols - 1)
+                                    : std::max(nearCol - 1, 0);
+                            out[0] = (l[col] - minValue) * scale;
+                            for (int ch = 0; ch < 2; ++ch)
+                            {
+                                out[ch + 1] = 0.5625f * cNear[nearCol][ch]
+                                        + 0.1875f * (cNear[farCol][ch] + cFar[nearCol][ch])
+                                        + 0.0625f * cFar[farCol][ch] + shift;
+                            }
+                        }
+                    }
+                }
+            });
+}
+
+/**
+ * Decoded frames of @param inputs in their order, taken from @param previous
+ * or with empty planes for frames which weren't there.
+ */
+vector<HDRCreator::DecodedFrame> slideWindow(const vector<HDRCreator::DecodedFrame> & previous,
+        const vector<kernel::GenericFramePtr> & inputs)
+{
+    vector<HDRCreator::DecodedFrame> window(inputs.size());
+    for (unsigned int exp = 0; exp < inputs.size(); ++exp)
+    {
+        window[exp].frame = inputs[exp];
+        for (const HDRCreator::DecodedFrame & decoded : previous)
+        {
+            if (decoded.frame == inputs[exp])
+            {
+                window[exp] = decoded;
+                break;
+            }
+        }
+    }
+    return window;
+}
+
+/**
+ * Luminance of expositions @param inputsL to @param hdrLuminance, both in half-floats,
+ * by @param processor in two passes over strips widened to float (statistics, mapping).
+ * Strips fit in cache, corrected luminances are narrowed back to @param inputsL.
+ * Only float processing has half-float storage.
+ */
+template<typename PixelType>
+void mapHalfLuminance(LuminanceProcessor<PixelType> & processor, kernel::BufferPool & pool,
+        vector<Mat> & inputsL, Mat & hdrLuminance, double & minL, double & maxL)
+{
+    assert(kernel::PixelTraits<PixelType>::depth == CV_32F);
+    const unsigned int exps = inputsL.size();
+    const int height = hdrLuminance.rows, width = hdrLuminance.cols;
+    // Every band of a strip (widened inputs and output) fits in cache.
+    const size_t rowBytes = (exps + 1) * width * sizeof(float);
+    const int stripRows = kernel::parallelBands(height)
+            * std::max<int>(1, kernel::l2CacheSize() / rowBytes);
+    vector<Mat> strip(exps);
+    auto widenRows = [&pool, &inputsL, &strip, exps, width](const Range & rows)
+    {
+        strip.assign(exps, Mat());
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            strip[exp] = pool.get(rows.size(), width, CV_32F);
+        }
+        kernel::parallelForRows(rows.size(), [&inputsL, &strip, &rows, exps](const Range & band)
+        {
+            for (unsigned int exp = 0; exp < exps; ++exp)
+            {
+                Mat widened = strip[exp].rowRange(band);
+                kernel::convertHalfToFloat(inputsL[exp].rowRange(rows.start + band.start,
+                        rows.start + band.end), widened);
+            }
+        });
+    };
 
-    virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs)
+    for (int first = 0; first < height; first += stripRows)
+    {
+        widenRows(Range(first, std::min(first + stripRows, height)));
+        processor.collectStrip(strip);
+    }
+    processor.finishStatistics(minL, maxL);
+    for (int first = 0; first < height; first += stripRows)
     {
-        outputIt = outputColor.begin<ChromaticityMatType>();
-        hdrIt = hdrLuminance.begin<float>();
-        for_each(inputsCH.begin(), inputsCH.end(), [this](Mat& m)
+        const Range rows(first, std::min(first + stripRows, height));
+        widenRows(rows);
+        Mat mapped = pool.get(rows.size(), width, CV_32F);
+        processor.mapStrip(mapped, strip);
+        kernel::parallelForRows(rows.size(), [&inputsL, &hdrLuminance, &strip, &mapped, &rows, exps](const Range & band)
         {
-            inputsCHIt.push_back(m.begin<ChromaticityMatType>());
+            const Range planeRows(rows.start + band.start, rows.start + band.end);
+            Mat narrowed = hdrLuminance.rowRange(planeRows);
+            kernel::convertFloatToHalf(mapped.rowRange(band), narrowed);
+            for (unsigned int exp = 0; exp < exps; ++exp)
+            {
+                narrowed = inputsL[exp].rowRange(planeRows);
+                kernel::convertFloatToHalf(strip[exp].rowRange(band), narrowed);
+            }
         });
-#ifndef NDEBUG
-        pixFromExp.resize(inputs.size());
-        for (int i = 0; i < inputs.size(); i++)
-            pixFromExp[i] = 0;
-#endif
-        kernel::GlobalOperation<float>::apply(output, inputs);
-        GaussianBlur(output, output, Size(3, 3), 1.5, 1.5);
     }
-};
+}
 
-bool extractColor(vector<kernel::GenericFramePtr> & originalInputs, Mat & output,
-        Mat & hdrLuminance, vector<Mat> & inputsL, vector<Mat> & inputsCH)
+/**
+ * Merge of expositions in Lab as a graph of tasks. Luminance is processed in PixelType,
+ * L of inputs is scaled by @param lScale, chromaticity is moved by @param abShift
+ * to output (CIELab float). L planes are stored as LuminanceRows, in half-floats they
+ * are processed in strips (no proxy statistics).
+ * With @param window decoded planes of frames are kept there and reused: L is copied,
+ * because luminance is processed in place, a*b* are only read.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+bool mergeLab(const GlobalArgs_t & globalArgs, kernel::BufferPool & pool,
+        kernel::GenericFramePtr outputFrame, vector<kernel::GenericFramePtr> & inputs,
+        double lScale, double abShift, vector<HDRCreator::DecodedFrame> * window = NULL)
 {
-    ChooseClosestColor<Vec2f> opColorPicker(originalInputs, hdrLuminance, inputsCH, output);
-    kernel::HDRExposition<float> colorPicker(hdrLuminance, inputsL);
-    colorPicker.addOperation(opColorPicker);
-    colorPicker.process();
-#ifndef NDEBUG
-    for (unsigned int i = 0; i < inputsL.size(); ++i)
+    typedef kernel::TaskGraph::task_t task_t;
+    unsigned int width = 0, height = 0;
+    unsigned int exps = inputs.size();
+    getSize(inputs.front()->getRawFrame(), width, height);
+    // Chromaticity may be merged at half resolution, upsampled when assembled.
+    const unsigned int chromaWidth = globalArgs.halfChroma ? (width + 1) / 2 : width;
+    const unsigned int chromaHeight = globalArgs.halfChroma ? (height + 1) / 2 : height;
+
+    vector<Mat> inputsL(exps), inputsCH(exps);
+    // 1 Luminance factor channel
+    Mat hdrLuminance;
+    // 2 Chromaticity channels
+    Mat hdrColor;
+    Mat output;
+
+    kernel::TaskGraph graph;
+    kernel::TaskGraph::dependencies_t decoded;
+    for (unsigned int exp = 0; exp < exps; ++exp)
     {
-        debug_print(LVL_DEBUG, "Color pixels picked from exp %d == %lu\n", i,
-                opColorPicker.pixFromExp[i]);
+        kernel::GenericFramePtr & gF = inputs[exp];
+        ostringstream name;
+        name << "exposure " << exp << ": decode L, a*b*";
+        HDRCreator::DecodedFrame * cached = window ? &(*window)[exp] : NULL;
+        decoded.push_back(graph.add(name.str(), [&gF, &pool, &inputsL, &inputsCH, cached, exp, height, width, chromaHeight, chromaWidth, lScale]()
+        {
+            const int lType = LuminanceRows<PixelType, ChromaticityMatType>::type;
+            const int abType = ChromaTraits<ChromaticityMatType>::type;
+            inputsL[exp] = pool.get(height, width, lType);
+            if (cached == NULL)
+            {
+                inputsCH[exp] = pool.get(chromaHeight, chromaWidth, abType);
+                return decodeLab<PixelType, ChromaticityMatType>(*gF, inputsL[exp], inputsCH[exp], lScale);
+            }
+            // Planes decoded for another mode are decoded again.
+            if ((cached->L.type() != lType) || (cached->ab.type() != abType)
+                    || (cached->ab.rows != (int) chromaHeight) || (cached->ab.cols != (int) chromaWidth))
+            {
+                cached->L = pool.get(height, width, lType);
+                cached->ab = pool.get(chromaHeight, chromaWidth, abType);
+                if (!decodeLab<PixelType, ChromaticityMatType>(*gF, cached->L, cached->ab, lScale))
+                {
+                    cached->L.release();
+                    return false;
+                }
+            }
+            cached->L.copyTo(inputsL[exp]);
+            inputsCH[exp] = cached->ab;
+            return true;
+        }));
+    }
+
+    double minL = 0, maxL = 0;
+    const unsigned int proxyLevels = globalArgs.proxyLevels;
+    task_t luminance = graph.add("process luminance", [&pool, &inputs, &inputsL, &hdrLuminance, &minL, &maxL, height, width, proxyLevels]()
+    {
+        hdrLuminance = pool.get(height, width, LuminanceRows<PixelType, ChromaticityMatType>::type);
+        LuminanceProcessor<PixelType> processor(inputs, pool, proxyLevels);
+        if (hdrLuminance.depth() != kernel::PixelTraits<PixelType>::depth)
+        {
+            if (proxyLevels > 0) return false;
+            mapHalfLuminance(processor, pool, inputsL, hdrLuminance, minL, maxL);
+            return true;
+        }
+        return processor.mapLuminance(hdrLuminance, inputsL, minL, maxL);
+    }, decoded);
+
+    kernel::TaskGraph::dependencies_t assembleDependencies;
+    // Colors are picked by luminances of inputs after camera correction.
+    assembleDependencies.push_back(graph.add("process chromaticity", [&pool, &inputsL, &inputsCH, &hdrColor, chromaHeight, chromaWidth]()
+    {
+        hdrColor = pool.get(chromaHeight, chromaWidth, ChromaTraits<ChromaticityMatType>::type);
+        bool properOut = extractColor<PixelType, ChromaticityMatType>(hdrColor, inputsL, inputsCH);
+        // Wont be used any more.
+        inputsL.clear();
+        inputsCH.clear();
+        return properOut;
+    }, luminance));
+    assembleDependencies.push_back(graph.add("allocate output", [&pool, &output, height, width]()
+    {
+        output = pool.get(height, width, CV_32FC3); // Lab
+        return true;
+    }));
+
+    graph.add("assemble Lab", [&output, &hdrLuminance, &hdrColor, &minL, &maxL, abShift]()
+    {
+        assembleLab<PixelType, ChromaticityMatType>(hdrLuminance, minL, maxL, hdrColor, abShift, output);
+        return true;
+    }, assembleDependencies);
+
+    bool merged = graph.run();
+    verbose_print(globalArgs.verbosity, "HDR creation graph:\n%s", graph.describe().c_str());
+    if (!merged) return false;
+
+    outputFrame->assignFrameTo(output, kernel::GenericFrame::COLOR_CIELab);
+    return true;
+}
+
+/**
+ * Out-of-core merge in two passes over strips of @param stripRows rows. The first one
+ * gathers statistics of luminance areas and range of output, the second one maps strips
+ * (with one row of margin for the blur of a*b*) and passes them to @param sink.
+ * Only inputs are kept whole, buffers have the size of a strip.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+bool mergeLabStrips(const GlobalArgs_t & globalArgs, kernel::BufferPool & pool,
+        vector<kernel::GenericFramePtr> & inputs, double lScale, double abShift, int stripRows,
+        const HDRCreator::strip_sink_t & sink)
+{
+    unsigned int width = 0, height = 0;
+    const unsigned int exps = inputs.size();
+    getSize(inputs.front()->getRawFrame(), width, height);
+    stripRows = std::min<int>(stripRows, height);
+
+    LuminanceProcessor<PixelType> processor(inputs, pool);
+    vector<Mat> inputsL(exps), inputsCH(exps);
+    // L and a*b* of rows of all expositions, previous strip is released first.
+    auto decodeRows = [&pool, &inputs, &inputsL, &inputsCH, exps, width, lScale](const Range & rows)
+    {
+        inputsL.assign(exps, Mat());
+        inputsCH.assign(exps, Mat());
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            inputsL[exp] = pool.get(rows.size(), width, kernel::PixelTraits<PixelType>::depth);
+            inputsCH[exp] = pool.get(rows.size(), width, ChromaTraits<ChromaticityMatType>::type);
+            if (!decodeLab<PixelType, ChromaticityMatType>(*inputs[exp], inputsL[exp],
+                    inputsCH[exp], lScale, rows)) return false;
+        }
+        return true;
+    };
+
+    for (int first = 0; first < (int) height; first += stripRows)
+    {
+        if (!decodeRows(Range(first, std::min<int>(first + stripRows, height)))) return false;
+        processor.collectStrip(inputsL);
+    }
+    double minL = 0, maxL = 0;
+    processor.finishStatistics(minL, maxL);
+    verbose_print(globalArgs.verbosity, "Statistics of %u strips collected.",
+            (height + stripRows - 1) / stripRows);
+
+    for (int first = 0; first < (int) height; first += stripRows)
+    {
+        const Range rows(first, std::min<int>(first + stripRows, height));
+        const Range margin(std::max(rows.start - 1, 0), std::min<int>(rows.end + 1, height));
+        const Range inner(rows.start - margin.start, rows.end - margin.start);
+        if (!decodeRows(margin)) return false;
+
+        Mat hdrLuminance = pool.get(margin.size(), width, kernel::PixelTraits<PixelType>::depth);
+        processor.mapStrip(hdrLuminance, inputsL);
+        Mat hdrColor = pool.get(margin.size(), width, ChromaTraits<ChromaticityMatType>::type);
+        if (!extractColor<PixelType, ChromaticityMatType>(hdrColor, inputsL, inputsCH)) return false;
+
+        Mat output = pool.get(rows.size(), width, CV_32FC3);
+        assembleLab<PixelType, ChromaticityMatType>(hdrLuminance.rowRange(inner), minL, maxL,
+                hdrColor.rowRange(inner), abShift, output);
+        if (!sink(output, rows.start)) return false;
+    }
+    return true;
+}
+
+/**
+ * 8-bit brackets are merged in fixed-point, without conversion to float.
+ */
+inline bool isFixedPoint(vector<kernel::GenericFramePtr> & inputs)
+{
+    bool fixedPoint = true;
+    std::for_each(inputs.begin(), inputs.end(), [&fixedPoint](kernel::GenericFramePtr & gF)
+    {
+        fixedPoint &= (gF->getRawFrame().depth() == CV_8U);
+    });
+    return fixedPoint;
+}
+
+/**
+ * All @param inputs are valid frames of the same size, rejected input is reported
+ * with @param verbosity.
+ */
+bool validInputs(const vector<kernel::GenericFramePtr> & inputs, int verbosity)
+{
+    if (inputs.empty())
+    {
+        verbose_print(verbosity, "Rejected: %s.", "no inputs");
+        return false;
+    }
+    for (unsigned int exp = 0; exp < inputs.size(); ++exp)
+    {
+        if ((inputs[exp] == NULL) || !inputs[exp]->isValid() || (inputs.front() == NULL)
+                || (inputs[exp]->getRawFrame().size() != inputs.front()->getRawFrame().size()))
+        {
+            verbose_print(verbosity, "Rejected: input %u is not valid or its size differs.", exp);
+            return false;
+        }
     }
-#endif
     return true;
 }
 
+bool HDRCreator::createInStrips(vector<kernel::GenericFramePtr> & inputs, strip_sink_t sink)
+{
+    if (!validInputs(inputs, globalArgs.verbosity)) return false;
+    if (globalArgs.halfChroma || (globalArgs.proxyLevels > 0))
+    {
+        // Strips are merged at full resolution only.
+        verbose_print(globalArgs.verbosity, "Rejected: %s.",
+                "strips cannot be merged with half chroma nor proxy statistics");
+        return false;
+    }
+    const int stripRows = (globalArgs.strips > 0) ? globalArgs.strips : defaultStripRows;
+
+    const bool fixedPoint = isFixedPoint(inputs);
+    verbose_print(globalArgs.verbosity, "Merging in %s, in strips of %d rows.",
+            fixedPoint ? "fixed-point" : (globalArgs.halfFloat ? "float, a*b* in half-float" : "float"),
+            stripRows);
+    if (fixedPoint)
+    {
+        return mergeLabStrips<unsigned short, Vec2b>(globalArgs, pool, inputs,
+                kernel::PixelTraits<unsigned short>::unit() / 255., -128, stripRows, sink);
+    }
+    if (globalArgs.halfFloat)
+    {
+        return mergeLabStrips<float, kernel::Vec2h>(globalArgs, pool, inputs, 1. / 100, 0,
+                stripRows, sink);
+    }
+    return mergeLabStrips<float, Vec2f>(globalArgs, pool, inputs, 1. / 100, 0, stripRows, sink);
+}
+
 bool HDRCreator::create(kernel::GenericFramePtr outputFrame,
         vector<kernel::GenericFramePtr> & inputs)
 {
     unsigned int width = 0, height = 0;
     unsigned int exps = inputs.size();
-    chrono::time_point < chrono::system_clock > lastTime;
-    lastTime = chrono::system_clock::now();
-
-    std::vector<boost::thread *> threads;
+    chrono::time_point < chrono::system_clock > startTime;
+    startTime = chrono::system_clock::now();
 
     verbose_print(globalArgs.verbosity, "HDR creation from %d input(s).", exps);
 
-    if ((outputFrame == 0) || (exps <= 0) || (inputs.front() == NULL)) return false;
+    if ((outputFrame == 0) || !validInputs(inputs, globalArgs.verbosity)) return false;
 
     getSize(inputs.front()->getRawFrame(), width, height);
     if ((width == 0) || (height == 0)) return false;
+    if ((globalArgs.proxyLevels > 0)
+            && !validProxyLevels(Size(width, height), globalArgs.proxyLevels))
+    {
+        verbose_print(globalArgs.verbosity, "Rejected: frames %ux%u cannot be decimated %u times.",
+                width, height, globalArgs.proxyLevels);
+        return false;
+    }
 
-    vector<Mat> inputsL, inputsCH;
-    inputsL.resize(exps);
-    inputsCH.resize(exps);
-
-    Mat hdrLuminance = cv::Mat(height, width, CV_32F); // 1 Luminance factor channel
-    Mat hdrColor = cv::Mat(height, width, CV_32FC2); // 2 Chromaticity channels
-
-    verbose_print(globalArgs.verbosity,
-            "Phase 1. Change colorspace.\t\tInitialization took [%ld ms].",
-            (chrono::duration_cast < std::chrono::milliseconds
-                    > (chrono::system_clock::now() - lastTime)).count());
-    lastTime = chrono::system_clock::now();
+    bool merged;
+    const bool fixedPoint = isFixedPoint(inputs);
+    // Frames which stay in the sliding window keep their decoded planes.
+    vector<DecodedFrame> window;
+    vector<DecodedFrame> * reused = NULL;
+    if (globalArgs.rollingWindow && (globalArgs.strips == 0))
     {
-        bool properOut = true;
-        std::for_each(inputs.begin(), inputs.end(),
-                [&properOut, &threads](kernel::GenericFramePtr & gF)
+        window = slideWindow(decodedFrames, inputs);
+        reused = &window;
+        verbose_print(globalArgs.verbosity, "%ld of %u frame(s) of the window decoded before.",
+                (long) std::count_if(window.begin(), window.end(), [](const DecodedFrame & frame)
                 {
-                    threads.push_back(new boost::thread(
-                                    [](bool &properOut, kernel::GenericFramePtr & gF)
-                                    {
-                                        properOut &= gF->convertToDepth(CV_32FC3);
-                                        properOut &= gF->convertToColorSpace(kernel::GenericFrame::COLOR_CIELab);
-                                    }, properOut, gF));
-                });
-        for_each(threads.begin(), threads.end(), [](boost::thread* t)
-        {   t->join(); delete t;});
-        threads.clear();
-        if (!properOut) return false;
-    }
-
-    verbose_print(globalArgs.verbosity, "Phase 2. Split channels.\t\tPhase 1 took [%ld ms].",
-            (chrono::duration_cast < std::chrono::milliseconds
-                    > (chrono::system_clock::now() - lastTime)).count());
-    lastTime = chrono::system_clock::now();
+                    return !frame.L.empty();
+                }), exps);
+    }
+    if (globalArgs.halfFloat && !fixedPoint && (globalArgs.proxyLevels > 0))
     {
-        int exp = 0;
-        std::for_each(inputs.begin(), inputs.end(),
-                [&exp, &inputsL, &inputsCH, &threads, height, width](kernel::GenericFramePtr & gF)
-                {
-                    threads.push_back(new boost::thread(
-                                    [&inputsL, &inputsCH, height, width](int exp, kernel::GenericFramePtr & gF)
-                                    {
-                                        Mat chromaOut = Mat(height, width, CV_32FC2);
-                                        Mat channel[3];
-                                        split(gF->getRawFrame(), channel);
-                                        inputsL[exp] = channel[0] / 100; // L
-                                        const int fromToChromaticity[] =
-                                        {   0, 0, 1, 1}; // a*b*
-                                        mixChannels(channel + 1, 2, &chromaOut, 1, fromToChromaticity, 2);
-                                        inputsCH[exp] = chromaOut;
-                                    }, exp, gF));
-                    exp++;
-                });
-        for_each(threads.begin(), threads.end(), [](boost::thread* t)
-        {   t->join(); delete t;});
-        threads.clear();
-    }
-
-    verbose_print(globalArgs.verbosity, "Phase 3. Process luminance.\t\tPhase 2 took [%ld ms].",
-            (chrono::duration_cast < std::chrono::milliseconds
-                    > (chrono::system_clock::now() - lastTime)).count());
-    lastTime = chrono::system_clock::now();
+        // Half-float luminance is processed in strips, without proxy.
+        verbose_print(globalArgs.verbosity, "Rejected: %s.",
+                "half-floats cannot be merged with proxy statistics");
+        return false;
+    }
+    if (globalArgs.strips > 0)
     {
-        LuminanceProcessor processor(inputs);
-        if (!processor.mapLuminance(hdrLuminance, inputsL)) return false;
-        //        *hdrLuminance.begin<float>() = 0;
-        //        *(++hdrLuminance.begin<float>()) = 1;
-        normalize(hdrLuminance, hdrLuminance, 0, 1, NORM_MINMAX);
+        // Whole output is assembled from strips.
+        Mat output(height, width, CV_32FC3);
+        merged = createInStrips(inputs, [&output](const Mat & strip, int firstRow)
+        {
+            Mat rows = output.rowRange(firstRow, firstRow + strip.rows);
+            strip.copyTo(rows);
+            return true;
+        });
+        if (merged) outputFrame->assignFrameTo(output, kernel::GenericFrame::COLOR_CIELab);
     }
-
-    verbose_print(globalArgs.verbosity, "Phase 4. Process chromaticity.\t\tPhase 3 took [%ld ms].",
-            (chrono::duration_cast < std::chrono::milliseconds
-                    > (chrono::system_clock::now() - lastTime)).count());
-    lastTime = chrono::system_clock::now();
+    else if (fixedPoint)
     {
-        if (!extractColor(inputs, hdrColor, hdrLuminance, inputsL, inputsCH)) return false;
+        verbose_print(globalArgs.verbosity, "Merging in %s.", "fixed-point");
+        // 8-bit L is L * 255 / 100, luminance is widened to 16-bit fixed-point,
+        // 8-bit a*b* are shifted by 128.
+        merged = mergeLab<unsigned short, Vec2b>(globalArgs, pool, outputFrame, inputs,
+                kernel::PixelTraits<unsigned short>::unit() / 255., -128, reused);
     }
-
-    threads.push_back(new boost::thread([&hdrLuminance]()
+    else if (globalArgs.halfFloat)
     {
-        normalize(hdrLuminance, hdrLuminance, 0, 100, NORM_MINMAX);
-    }));
-    // Wont be used any more.
-    inputsL.clear();
-    inputsCH.clear();
-    // Create output.
-    Mat output = cv::Mat(height, width, CV_32FC3); // Lab
-
-    for_each(threads.begin(), threads.end(), [](boost::thread* t)
-    {   t->join(); delete t;});
-    verbose_print(globalArgs.verbosity, "Phase 5. Mix channels.\t\tPhase 4 took [%ld ms].",
-            (chrono::duration_cast < std::chrono::milliseconds
-                    > (chrono::system_clock::now() - lastTime)).count());
-    lastTime = chrono::system_clock::now();
+        verbose_print(globalArgs.verbosity, "Merging in %s.", "float, L and a*b* in half-float");
+        // Only the storage of L and a*b* is 16-bit, they are widened to float when processed.
+        merged = mergeLab<float, kernel::Vec2h>(globalArgs, pool, outputFrame, inputs, 1. / 100, 0,
+                reused);
+    }
+    else
     {
-        // Luminance
-        const int fromToLuminanace[] =
-        { 0, 0 }; // L*
-        mixChannels(&hdrLuminance, 1, &output, 1, fromToLuminanace, 1);
-        // Color
-        const int fromToColor[] =
-        { 0, 1, 1, 2 }; // a*b*
-        mixChannels(&hdrColor, 1, &output, 1, fromToColor, 2);
+        verbose_print(globalArgs.verbosity, "Merging in %s.", "float");
+        merged = mergeLab<float, Vec2f>(globalArgs, pool, outputFrame, inputs, 1. / 100, 0, reused);
     }
+    if (!merged)
+    {
+        // Planes of a failed merge may be decoded only in part.
+        decodedFrames.clear();
+        return false;
+    }
+    decodedFrames.swap(window);
 
-    outputFrame->assignFrameTo(output, kernel::GenericFrame::COLOR_CIELab);
-    verbose_print(globalArgs.verbosity, "Finished. \t\tPhase 5 took [%ld ms].",
+    verbose_print(globalArgs.verbosity, "Finished. \t\tHDR creation took [%ld ms].",
             (chrono::duration_cast < std::chrono::milliseconds
-                    > (chrono::system_clock::now() - lastTime)).count());
+                    > (chrono::system_clock::now() - startTime)).count());
+    verbose_print(globalArgs.verbosity, "Buffer pool: %lu buffers, %lu allocations, %lu reuses.",
+            (unsigned long) pool.size(), pool.getAllocations(), pool.getReuses());
     return true;
 }
 
@@ -31,9 +31,11 @@
 #define HDRCREATOR_H_
 
 #include "config.h"
+#include "kernel/BufferPool.hpp"
 #include "kernel/GenericFrame.hpp"
 #include "kernel/HDRExposition.hpp"
 #include <boost/shared_ptr.hpp>
+#include <functional>
 #include <vector>
 
 namespace HDRCreation
@@ -44,12 +46,54 @@ namespace HDRCreation
  */
 class HDRCreator
 {
+public:
+    /*
+     * L and a*b* of a frame, decoded once and reused while the frame stays in
+     * the sliding window of consecutive create calls.
+     */
+    struct DecodedFrame
+    {
+        kernel::GenericFramePtr frame;
+        cv::Mat L, ab;
+    };
+
 private:
     const GlobalArgs_t & globalArgs;
+    // Buffers reused by consecutive create calls.
+    kernel::BufferPool pool;
+    // Frames of the last create call (globalArgs.rollingWindow).
+    std::vector<DecodedFrame> decodedFrames;
 public:
+    /**
+     * Receives a strip of output (CIELab, CV_32FC3) and index of its first row,
+     * the strip is valid only during the call.
+     */
+    typedef std::function<bool(const cv::Mat & strip, int firstRow)> strip_sink_t;
+
+    // Rows of strips if globalArgs.strips isn't set.
+    static const int defaultStripRows = 256;
+    // Most levels of proxy statistics (globalArgs.proxyLevels) for any frame,
+    // frames have to keep at least one pixel after decimation.
+    static const unsigned int maxProxyLevels = 15;
+
     explicit HDRCreator(const GlobalArgs_t & globalArgs);
 
+    /**
+     * HDR image from @param frames to @param output. With globalArgs.strips set
+     * it is merged out-of-core by @method createInStrips and assembled.
+     * With globalArgs.rollingWindow frames which were passed to the previous call
+     * (the same objects) aren't decoded again.
+     */
     bool create(kernel::GenericFramePtr output, std::vector<kernel::GenericFramePtr> & frames);
+
+    /**
+     * Out-of-core creation, only frames are kept whole, output is produced strip by strip
+     * (globalArgs.strips rows) and passed to @param sink in order. Memory for processing
+     * depends on the height of strips, not of the image.
+     */
+    bool createInStrips(std::vector<kernel::GenericFramePtr> & frames, strip_sink_t sink);
+
+    kernel::BufferPool & getBufferPool();
 };
 
 } /* namespace HDRCreation */
@@ -31,6 +31,8 @@
 
 #include <kernel/HDRExposition.hpp>
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <limits>
 #include <vector>
 
 using namespace cv;
@@ -39,135 +41,196 @@ using namespace std;
 namespace HDRCreation
 {
 
-LuminanceProcessor::LuminanceProcessor(std::vector<kernel::GenericFramePtr> & originalInputs)
-        : originalInputs(originalInputs)
+namespace
 {
-}
-
-Mat & LuminanceProcessor::CameraCorrection::preprocess(Mat & m)
-{
-    pow(m, 0.7, m);
-    return m;
-}
 
-Mat & LuminanceProcessor::CameraCorrectionPost::preprocess(Mat & m)
+/**
+ * Sums of all exposures on a span, for N exposures all sums are kept in registers.
+ */
+template<unsigned int N>
+struct SumExposures
 {
-    pow(m, 1./0.7, m);
-    return m;
-}
+    template<typename PixelType>
+    static void run(unsigned int exps, const PixelType * const inputs[], size_t length,
+            vector<double> & sums)
+    {
+        kernel::ExposureArray<double, N> acc(N);
+        for (unsigned int exp = 0; exp < N; ++exp)
+        {
+            acc[exp] = 0;
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            for (unsigned int exp = 0; exp < N; ++exp)
+            {
+                acc[exp] += inputs[exp][i];
+            }
+        }
+        for (unsigned int exp = 0; exp < N; ++exp)
+        {
+            sums[exp] += acc[exp];
+        }
+    }
+};
 
-void LuminanceProcessor::ThresholdBasedPartitionBuilder::createNewThresholdArea(Mat & m,
-        Mat & partitions, vector<unsigned int> & thisPartition, unsigned int ident)
+template<>
+struct SumExposures<0>
 {
-    assert(ident > 0);
+    template<typename PixelType>
+    static void run(unsigned int exps, const PixelType * const inputs[], size_t length,
+            vector<double> & sums)
+    {
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            const PixelType * input = inputs[exp];
+            double sum = 0;
+            for (size_t i = 0; i < length; ++i)
+            {
+                sum += input[i];
+            }
+            sums[exp] += sum;
+        }
+    }
+};
 
-    MatIterator_<unsigned char> partitionsIt = partitions.begin<unsigned char>();
-    MatIterator_<unsigned char> partitionsEnd = partitions.end<unsigned char>();
+// Well exposed range of pixels, in units.
+const float underexposure = 0.1, overexposure = 0.9;
 
-    unsigned int shift = 0;
-    for_each(m.begin<float>(), m.end<float>(),
-            [this, &partitionsIt, &partitionsEnd, &thisPartition, &shift, &ident](float v)
-            {
-                assert(partitionsIt != partitionsEnd);
+} /* anonymous namespace */
 
-                // Create area only in blank.
-                if (*partitionsIt == 0)
-                {
-                    if ((v > t0) && (v < t1))
-                    {
-                        *partitionsIt = ident;
-                        thisPartition.push_back(shift);
-                        shift = 0;
-                    }
-                }
-                shift++;
-                partitionsIt++;
-            });
-    assert(partitionsIt == partitionsEnd);
+template<typename PixelType>
+LuminanceProcessor<PixelType>::LuminanceProcessor(
+        std::vector<kernel::GenericFramePtr> & originalInputs, kernel::BufferPool & pool,
+        unsigned int proxyLevels)
+        : originalInputs(originalInputs), pool(pool), proxyLevels(proxyLevels)
+{
 }
 
-LuminanceProcessor::ThresholdBasedPartitionBuilder::ThresholdBasedPartitionBuilder(Size s, float t0,
-        float t1)
-        : t0(t0), t1(t1), s(s)
+template<typename PixelType>
+LuminanceProcessor<PixelType>::Gamma::Gamma(double gamma)
+        : gamma(gamma)
 {
-    // This creates assumption that maximum number of expositions cannot extend 255
-    // (256 - 1 (blank area)). Any new exposition can create new partition area.
+    if (kernel::PixelTraits<PixelType>::depth == CV_32F) return;
+    const double unit = kernel::PixelTraits<PixelType>::unit();
+    table.resize((size_t) unit + 1);
+    for (size_t v = 0; v < table.size(); ++v)
+    {
+        table[v] = saturate_cast<PixelType>(unit * std::pow(v / unit, gamma));
+    }
 }
 
-void LuminanceProcessor::ThresholdBasedPartitionBuilder::apply(vector<Mat> & inputs)
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::Gamma::apply(Mat & m) const
 {
-    unsigned char currentProperAreaNo = 0;
-    Mat partitionsTmp = Mat::zeros(s, CV_8U);
-    for_each(inputs.begin(), inputs.end(),
-            [this, &partitionsTmp, &currentProperAreaNo](Mat & m)
-            {
-                vector<unsigned int> newPartition;
-                createNewThresholdArea(m, partitionsTmp, newPartition, currentProperAreaNo + 1);
-                partitions.push_back(pair<unsigned char, vector<unsigned int>>(currentProperAreaNo++, newPartition));
-            });
+    if (table.empty())
+    {
+        pow(m, gamma, m);
+        return;
+    }
+    assert(m.depth() == kernel::PixelTraits<PixelType>::depth);
+    const int cols = m.cols * m.channels();
+    for (int row = 0; row < m.rows; ++row)
+    {
+        PixelType * v = m.ptr<PixelType>(row);
+        for (int col = 0; col < cols; ++col)
+        {
+            v[col] = table[v[col]];
+        }
+    }
+}
 
-    // Add 0 to as blank partition
-    unsigned int shift = 0;
-    vector<unsigned int> newPartition;
-    for_each(partitionsTmp.begin<unsigned char>(), partitionsTmp.end<unsigned char>(),
-            [&shift, &newPartition](unsigned char v)
-            {
-                if (v == 0)
-                {
-                    newPartition.push_back(shift);
-                    shift = 0;
-                }
-                shift++;
-            });
-    partitions.push_back(
-            pair<unsigned char, vector<unsigned int>>(currentProperAreaNo++, newPartition));
+template<typename PixelType>
+double LuminanceProcessor<PixelType>::Gamma::operator()(double v) const
+{
+    if (table.empty()) return std::pow(v, gamma);
+    return table[(size_t) v];
+}
 
-    noOfPartitions = currentProperAreaNo;
+template<typename PixelType>
+Mat & LuminanceProcessor<PixelType>::CameraCorrection::preprocess(Mat & m)
+{
+    gamma.apply(m);
+    return m;
 }
 
-Mat & LuminanceProcessor::ThresholdBasedPartitionBuilder::preprocess(Mat & m)
+template<typename PixelType>
+Mat & LuminanceProcessor<PixelType>::CameraCorrectionPost::preprocess(Mat & m)
 {
+    gamma.apply(m);
     return m;
 }
 
-LuminanceProcessor::PartitionDataCollector::PartitionDataCollector(
-        kernel::Partition<float, unsigned char, unsigned int> & partitions,
-        std::vector<kernel::GenericFramePtr> & originalInputs)
-        : kernel::LocalOperation<float, unsigned char, unsigned int>(partitions), originalInputs(
-                originalInputs)
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::OutputCorrection::apply(Mat & output, vector<Mat> & inputs)
 {
-    debug_print(LVL_DEBUG, "Creating new partition datas for %d areas.\n", partitions.size());
-    data.resize(size()); // most likely size == 0 while constructing.
+    gamma.apply(output);
 }
 
-float LuminanceProcessor::PartitionDataCollector::process(float inputs[], unsigned int exps)
+template<typename PixelType>
+unsigned int LuminanceProcessor<PixelType>::ThresholdBasedPartitionBuilder::areaOf(
+        const PixelType * const inputs[], unsigned int exps, size_t i, float t0, float t1)
 {
-    data[ident].noOfPixels++;
-    for (unsigned char exp = 0; exp < exps; ++exp)
+    for (unsigned int exp = 0; exp < exps; ++exp)
     {
-        data[ident].avgOfAllExp[exp] += inputs[exp];
+        if ((inputs[exp][i] > t0) && (inputs[exp][i] < t1)) return exp;
     }
-    return inputs[0]; // doesn't matter
+    return exps;
 }
-void LuminanceProcessor::PartitionDataCollector::enterArea(unsigned char ident)
+
+template<typename PixelType>
+LuminanceProcessor<PixelType>::ThresholdBasedPartitionBuilder::ThresholdBasedPartitionBuilder(
+        Mat labels, float t0, float t1)
+        : t0(threshold(t0)), t1(threshold(t1)), labels(labels)
 {
-    this->ident = ident;
-    debug_print(LVL_DEBUG, "Creating new partition data %d/%d.\n", ident + 1, size());
-    data.resize(size()); // most likely size == 0 while constructing.
-    data[ident] = PartitionData
-    { 0, vector<double>(), 0, 0 };
-    data[ident].avgOfAllExp.resize(originalInputs.size());
-    for_each(data[ident].avgOfAllExp.begin(), data[ident].avgOfAllExp.end(), [](double & avgVal){
-        avgVal = 0;
-    });
+    // This creates assumption that maximum number of expositions cannot extend 255
+    // (256 - 1 (blank area)). Any new exposition can create new partition area.
 }
-void LuminanceProcessor::PartitionDataCollector::leaveArea(unsigned char ident)
+
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::ThresholdBasedPartitionBuilder::apply(vector<Mat> & inputs)
+{
+    assert(labels.type() == CV_8U);
+    assert(labels.size() == inputs.front().size());
+    const unsigned int exps = inputs.size();
+    // Area exp of the first exposition in range, blank area (exps) is the last one.
+    vector<spans_t> areas(exps + 1);
+    vector<const PixelType *> values(exps);
+    for (int row = 0; row < labels.rows; ++row)
+    {
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            values[exp] = inputs[exp].ptr<PixelType>(row);
+        }
+        unsigned char * label = labels.ptr<unsigned char>(row);
+        for (int col = 0; col < labels.cols; ++col)
+        {
+            const unsigned int area = areaOf(values.data(), exps, col, t0, t1);
+            label[col] = (area < exps) ? area + 1 : 0;
+            this->addPixel(areas[area], row, col);
+        }
+    }
+    for (unsigned int area = 0; area <= exps; ++area)
+    {
+        this->partitions.push_back(pair<unsigned char, spans_t>(area, areas[area]));
+    }
+    this->noOfPartitions = exps + 1;
+}
+
+template<typename PixelType>
+Mat & LuminanceProcessor<PixelType>::ThresholdBasedPartitionBuilder::preprocess(Mat & m)
+{
+    return m;
+}
+
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::finaliseArea(unsigned char ident, PartitionData & acc,
+        std::vector<kernel::GenericFramePtr> & originalInputs)
 {
-    // aggregate
-    unsigned long long & noOfPixels = data[ident].noOfPixels;
+    // aggregate, averages are in [0, 1] for any pixel type
+    const double noOfUnits = acc.noOfPixels * (double) kernel::PixelTraits<PixelType>::unit();
     unsigned char exp = 0;
-    for_each(data[ident].avgOfAllExp.begin(), data[ident].avgOfAllExp.end(), [&noOfPixels, &exp, &ident](double & avgVal){
-        avgVal /= noOfPixels;
+    for_each(acc.avgOfAllExp.begin(), acc.avgOfAllExp.end(), [noOfUnits, &exp, &ident](double & avgVal){
+        avgVal /= noOfUnits;
         debug_print(LVL_INFO, "Area %d, exposition %d, avg pixel val %f\n", ident, exp, avgVal);
         exp++;
     });
@@ -175,12 +238,11 @@ void LuminanceProcessor::PartitionDataCollector::leaveArea(unsigned char ident)
     if (ident >= originalInputs.size())
     {
         // this area wasn't catched in any exposition
-        data[ident].avgValOfMaxPriorExp = data[ident].avgOfAllExp[ident];
         double minDist = 1;
         double closestTo = 0.5;
         unsigned char minDistIndex = 0;
         unsigned char currentIndex = 0;
-        std::for_each(data[ident].avgOfAllExp.begin(), data[ident].avgOfAllExp.end(),
+        std::for_each(acc.avgOfAllExp.begin(), acc.avgOfAllExp.end(),
                 [&minDist, &closestTo, &minDistIndex, &currentIndex](double & avgVal)
                 {
                     if (abs(avgVal - closestTo) < minDist)
@@ -190,72 +252,560 @@ void LuminanceProcessor::PartitionDataCollector::leaveArea(unsigned char ident)
                     }
                     currentIndex++;
                 });
-        data[ident].avgValOfMaxPriorExp = data[ident].avgOfAllExp[minDistIndex];
-        data[ident].evShift = originalInputs[ident - 1]->getEV().get();
+        acc.avgValOfMaxPriorExp = acc.avgOfAllExp[minDistIndex];
+        acc.evShift = originalInputs[ident - 1]->getEV().get();
     }
     else
     {
-        data[ident].avgValOfMaxPriorExp = data[ident].avgOfAllExp[ident];
-        data[ident].evShift = originalInputs[ident]->getEV().get();
+        acc.avgValOfMaxPriorExp = acc.avgOfAllExp[ident];
+        acc.evShift = originalInputs[ident]->getEV().get();
     }
 
 }
-std::vector<LuminanceProcessor::PartitionData> & LuminanceProcessor::PartitionDataCollector::getData()
+template<typename PixelType>
+LuminanceProcessor<PixelType>::PartitionDataCollector::PartitionDataCollector(
+        partition_t & partitions, std::vector<kernel::GenericFramePtr> & originalInputs)
+        : kernel::LocalReduction<PixelType, unsigned char, unsigned int, PartitionData>(partitions), originalInputs(
+                originalInputs)
 {
-    return data;
+    debug_print(LVL_DEBUG, "Creating new partition datas for %d areas.\n", partitions.size());
 }
 
-LuminanceProcessor::HistogramShifter::HistogramShifter(
-        kernel::Partition<float, unsigned char, unsigned int> & partitions,
-        std::vector<LuminanceProcessor::PartitionData> & data)
-        : kernel::LocalOperation<float, unsigned char, unsigned int>(partitions), data(data)
+template<typename PixelType>
+typename LuminanceProcessor<PixelType>::PartitionData LuminanceProcessor<PixelType>::PartitionDataCollector::initial(
+        unsigned char ident)
+{
+    return PartitionData
+    { 0, vector<double>(originalInputs.size(), 0), 0, 0 };
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::PartitionDataCollector::addSpan(PartitionData & acc,
+        const PixelType * const inputs[], unsigned int exps, size_t length)
+{
+    acc.noOfPixels += length;
+    kernel::dispatchExposures<SumExposures>(exps, inputs, length, acc.avgOfAllExp);
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::PartitionDataCollector::accumulate(PartitionData & acc,
+        const PixelType * const inputs[], unsigned int exps, size_t length)
+{
+    addSpan(acc, inputs, exps, length);
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::PartitionDataCollector::combine(PartitionData & acc,
+        const PartitionData & other)
+{
+    acc.noOfPixels += other.noOfPixels;
+    for (unsigned int exp = 0; exp < other.avgOfAllExp.size(); ++exp)
+    {
+        acc.avgOfAllExp[exp] += other.avgOfAllExp[exp];
+    }
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::PartitionDataCollector::finalise(unsigned char ident,
+        PartitionData & acc)
+{
+    debug_print(LVL_DEBUG, "Partition data %d/%d collected.\n", ident + 1, this->size());
+    finaliseArea(ident, acc, originalInputs);
+}
+template<typename PixelType>
+std::vector<typename LuminanceProcessor<PixelType>::PartitionData> & LuminanceProcessor<PixelType>::PartitionDataCollector::getData()
+{
+    return this->results();
+}
+
+template<typename PixelType>
+LuminanceProcessor<PixelType>::HistogramShifter::HistogramShifter(partition_t & partitions,
+        std::vector<PartitionData> & data)
+        : super(partitions), data(data), ident(0), areaShift(0), minValue(
+                std::numeric_limits<PixelType>::max()), maxValue(
+                std::numeric_limits<PixelType>::lowest())
 {
 }
 
-float LuminanceProcessor::HistogramShifter::process(float inputs[], unsigned int exps)
+template<typename PixelType>
+typename LuminanceProcessor<PixelType>::HistogramShifter::shift_t LuminanceProcessor<PixelType>::HistogramShifter::shiftOf(
+        unsigned char ident) const
+{
+    return shiftOf(data[ident]);
+}
+template<typename PixelType>
+typename LuminanceProcessor<PixelType>::HistogramShifter::shift_t LuminanceProcessor<PixelType>::HistogramShifter::shiftOf(
+        const PartitionData & data)
+{
+    const double shift = log1p(data.avgValOfMaxPriorExp);
+    if (std::is_integral<PixelType>::value)
+    {
+        return (shift_t) lround(shift * kernel::PixelTraits<PixelType>::unit());
+    }
+    return shift;
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::HistogramShifter::shift(const PixelType * input,
+        shift_t areaShift, PixelType * output, size_t length, PixelType & minValue,
+        PixelType & maxValue)
+{
+    PixelType lo = minValue, hi = maxValue;
+    for (size_t i = 0; i < length; ++i)
+    {
+        output[i] = input[i] + areaShift;
+        lo = std::min(lo, output[i]);
+        hi = std::max(hi, output[i]);
+    }
+    minValue = lo;
+    maxValue = hi;
+}
+/**
+ * Fixed-point shift at half scale, input + shift <= 1.7 unit.
+ */
+template<>
+void LuminanceProcessor<unsigned char>::HistogramShifter::shift(const unsigned char * input,
+        unsigned int areaShift, unsigned char * output, size_t length, unsigned char & minValue,
+        unsigned char & maxValue)
+{
+    unsigned char lo = minValue, hi = maxValue;
+    for (size_t i = 0; i < length; ++i)
+    {
+        output[i] = (input[i] + areaShift) >> 1;
+        lo = std::min(lo, output[i]);
+        hi = std::max(hi, output[i]);
+    }
+    minValue = lo;
+    maxValue = hi;
+}
+template<>
+void LuminanceProcessor<unsigned short>::HistogramShifter::shift(const unsigned short * input,
+        unsigned int areaShift, unsigned short * output, size_t length, unsigned short & minValue,
+        unsigned short & maxValue)
+{
+    unsigned short lo = minValue, hi = maxValue;
+    for (size_t i = 0; i < length; ++i)
+    {
+        output[i] = (input[i] + areaShift) >> 1;
+        lo = std::min(lo, output[i]);
+        hi = std::max(hi, output[i]);
+    }
+    minValue = lo;
+    maxValue = hi;
+}
+
+template<typename PixelType>
+PixelType LuminanceProcessor<PixelType>::HistogramShifter::process(PixelType inputs[],
+        unsigned int exps)
 {
 #ifndef NDEBUG
     c++;
 #endif
-    return inputs[min((unsigned int) ident, exps - 1)] + areaShift;;
+    PixelType output;
+    shift(inputs + sourceOf(ident, exps), areaShift, &output, 1, minValue, maxValue);
+    return output;
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::HistogramShifter::processSpan(const PixelType * const inputs[],
+        unsigned int exps, PixelType * output, size_t length)
+{
+#ifndef NDEBUG
+    c += length;
+#endif
+    shift(inputs[sourceOf(ident, exps)], areaShift, output, length, minValue,
+            maxValue);
+}
+template<typename PixelType>
+typename LuminanceProcessor<PixelType>::HistogramShifter::AreaStatePtr LuminanceProcessor<PixelType>::HistogramShifter::createAreaState(
+        unsigned char ident)
+{
+    ShiftState * state = new ShiftState();
+    state->ident = ident;
+    state->areaShift = shiftOf(ident);
+    state->noOfPixels = 0;
+    state->minValue = std::numeric_limits<PixelType>::max();
+    state->maxValue = std::numeric_limits<PixelType>::lowest();
+    return AreaStatePtr(state);
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::HistogramShifter::processAreaSpan(AreaState & state,
+        const PixelType * const inputs[], unsigned int exps, PixelType * output, size_t length)
+{
+    ShiftState & shiftState = static_cast<ShiftState &>(state);
+    shiftState.noOfPixels += length;
+    shift(inputs[sourceOf(shiftState.ident, exps)], shiftState.areaShift, output,
+            length, shiftState.minValue, shiftState.maxValue);
+}
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::HistogramShifter::mergeArea(unsigned char ident,
+        AreaState & state)
+{
+    ShiftState & shiftState = static_cast<ShiftState &>(state);
+    minValue = std::min(minValue, shiftState.minValue);
+    maxValue = std::max(maxValue, shiftState.maxValue);
+#ifndef NDEBUG
+    c += shiftState.noOfPixels;
+#endif
 }
-void LuminanceProcessor::HistogramShifter::enterArea(unsigned char ident)
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::HistogramShifter::enterArea(unsigned char ident)
 {
-    areaShift = log1p(data[ident].avgValOfMaxPriorExp);
-    debug_print(LVL_DEBUG, "Entering partition %d, global shift by= %f.\n", ident, areaShift);
+    areaShift = shiftOf(ident);
+    debug_print(LVL_DEBUG, "Entering partition %d, global shift by= %f.\n", ident,
+            (double) areaShift);
     this->ident = ident;
 #ifndef NDEBUG
     c = 0;
 #endif
 }
-void LuminanceProcessor::HistogramShifter::leaveArea(unsigned char ident)
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::HistogramShifter::leaveArea(unsigned char ident)
 {
 #ifndef NDEBUG
     debug_print(LVL_DEBUG, "Leaving partition %u, no of pix %lu\n", (unsigned int )ident, c);
+    c = 0;
 #endif
 }
 
-bool LuminanceProcessor::mapLuminance(Mat & output, vector<Mat> & inputs)
+template<typename PixelType>
+LuminanceProcessor<PixelType>::ProxyHistogramShifter::ProxyHistogramShifter(
+        ThresholdBasedPartitionBuilder & partitions, std::vector<PartitionData> & data,
+        unsigned int levels)
+        : HistogramShifter(partitions, data), labels(partitions.getLabels()), levels(levels), expOfLabel(
+                256, 0), shiftOfLabel(256, 0)
+{
+    // Label 0 is the blank area, the last one, label l > 0 is area l - 1.
+    const unsigned char areas = partitions.size();
+    for (unsigned int label = 0; label <= areas; ++label)
+    {
+        const unsigned char ident = (label == 0) ? areas - 1 : label - 1;
+        expOfLabel[label] = ident;
+        shiftOfLabel[label] = this->shiftOf(ident);
+    }
+}
+
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::ProxyHistogramShifter::apply(Mat & output,
+        vector<Mat> & inputs)
+{
+    // Output may be a tile, labels are looked up by position in the whole frame.
+    Size wholeSize;
+    Point offset;
+    output.locateROI(wholeSize, offset);
+    const unsigned int exps = inputs.size();
+    PixelType lo = std::numeric_limits<PixelType>::max();
+    PixelType hi = std::numeric_limits<PixelType>::lowest();
+    for (int row = 0; row < output.rows; ++row)
+    {
+        const unsigned char * label = labels.ptr<unsigned char>((offset.y + row) >> levels);
+        PixelType * out = output.ptr<PixelType>(row);
+        int col = 0;
+        while (col < output.cols)
+        {
+            // Run of pixels of one label, at least one proxy pixel wide.
+            const unsigned char l = label[(offset.x + col) >> levels];
+            int end = col + 1;
+            while ((end < output.cols) && (label[(offset.x + end) >> levels] == l))
+            {
+                ++end;
+            }
+            const unsigned int exp = this->sourceOf(expOfLabel[l], exps);
+            this->shift(inputs[exp].template ptr<PixelType>(row) + col, shiftOfLabel[l], out + col,
+                    end - col, lo, hi);
+            col = end;
+        }
+    }
+    boost::mutex::scoped_lock lock(mutex);
+    this->minValue = std::min(this->minValue, lo);
+    this->maxValue = std::max(this->maxValue, hi);
+}
+
+template<typename PixelType>
+bool LuminanceProcessor<PixelType>::mapLuminance(Mat & output, vector<Mat> & inputs,
+        double & minValue, double & maxValue)
 {
     // Inputs will be overridden.
+    if (proxyLevels > 0)
+    {
+        if (!validProxyLevels(output.size(), proxyLevels))
+        {
+            debug_print(LVL_ERROR, "Frames %dx%d cannot be decimated %u times.\n", output.cols,
+                    output.rows, proxyLevels);
+            return false;
+        }
+        return mapLuminanceOnProxy(output, inputs, minValue, maxValue);
+    }
 
-    kernel::HDRExposition<float> expositions(output, inputs);
+    kernel::HDRExposition<PixelType> expositions(output, inputs);
 
     CameraCorrection opCorrect(originalInputs);
     CameraCorrectionPost opPostCorrect(originalInputs);
-    ThresholdBasedPartitionBuilder opPartition(inputs.front().size(), 0.1, 0.9); // as argument -> FUTURE
+    ThresholdBasedPartitionBuilder opPartition(pool.get(inputs.front().size(), CV_8U), underexposure,
+            overexposure); // as argument -> FUTURE
     PartitionDataCollector opDataCollector(opPartition, originalInputs);
     HistogramShifter opHistogramShifer(opPartition, opDataCollector.getData());
+    OutputCorrection opOutputCorrect;
 
     expositions.addOperation(opCorrect);
     expositions.addOperation(opPartition);
     expositions.addOperation(opDataCollector);
     expositions.addOperation(opHistogramShifer);
     expositions.addOperation(opPostCorrect);
+    expositions.addOperation(opOutputCorrect); // streamed together with opPostCorrect
+
+    expositions.process();
+    // Shifted values are only gamma corrected afterwards.
+    minValue = opOutputCorrect.correct(opHistogramShifer.getMin());
+    maxValue = opOutputCorrect.correct(opHistogramShifer.getMax());
+    debug_print(LVL_DEBUG, "Luminance in [%f, %f].\n", minValue, maxValue);
+    return true;
+}
 
+template<typename PixelType>
+bool LuminanceProcessor<PixelType>::mapLuminanceOnProxy(Mat & output, vector<Mat> & inputs,
+        double & minValue, double & maxValue)
+{
+    CameraCorrection opCorrect(originalInputs);
+    CameraCorrectionPost opPostCorrect(originalInputs);
+    OutputCorrection opOutputCorrect;
+
+    // Statistics are collected from corrected inputs.
+    kernel::HDRExposition<PixelType> corrected(output, inputs);
+    corrected.addOperation(opCorrect);
+    corrected.process();
+
+    const int factor = 1 << proxyLevels;
+    const Size proxySize((output.cols + factor - 1) >> proxyLevels,
+            (output.rows + factor - 1) >> proxyLevels);
+    const Size paddedSize(proxySize.width << proxyLevels, proxySize.height << proxyLevels);
+    vector<Mat> proxies(inputs.size()), padded(inputs.size());
+    for (unsigned int exp = 0; exp < inputs.size(); ++exp)
+    {
+        proxies[exp] = pool.get(proxySize, inputs[exp].type());
+        if (paddedSize != inputs[exp].size())
+        {
+            padded[exp] = pool.get(paddedSize, inputs[exp].type());
+        }
+    }
+    const unsigned int levels = proxyLevels;
+    kernel::parallelForRows(inputs.size(), [&inputs, &proxies, &padded, levels](const Range & range)
+    {
+        for (int exp = range.start; exp < range.end; ++exp)
+        {
+            decimate(inputs[exp], proxies[exp], levels, padded[exp]);
+        }
+    });
+    debug_print(LVL_DEBUG, "Partition statistics on proxy %dx%d.\n", proxySize.width,
+            proxySize.height);
+
+    Mat proxyOutput = pool.get(proxySize, output.type());
+    kernel::HDRExposition<PixelType> statistics(proxyOutput, proxies);
+    ThresholdBasedPartitionBuilder opPartition(pool.get(proxySize, CV_8U), underexposure,
+            overexposure);
+    PartitionDataCollector opDataCollector(opPartition, originalInputs);
+    statistics.addOperation(opPartition);
+    statistics.addOperation(opDataCollector);
+    statistics.process();
+
+    kernel::HDRExposition<PixelType> expositions(output, inputs);
+    ProxyHistogramShifter opHistogramShifer(opPartition, opDataCollector.getData(), proxyLevels);
+    expositions.addOperation(opHistogramShifer);
+    expositions.addOperation(opPostCorrect);
+    expositions.addOperation(opOutputCorrect); // all streamed in one sweep
     expositions.process();
-    pow(output, 1./0.7, output);
+
+    minValue = opOutputCorrect.correct(opHistogramShifer.getMin());
+    maxValue = opOutputCorrect.correct(opHistogramShifer.getMax());
+    debug_print(LVL_DEBUG, "Luminance in [%f, %f].\n", minValue, maxValue);
     return true;
 }
 
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::decimate(const Mat & input, Mat & proxy, unsigned int levels,
+        Mat & padded)
+{
+    // Labels of the proxy are looked up by (row >> levels, col >> levels), resize has to
+    // average whole blocks of 2^levels pixels, also at the right and bottom borders.
+    const int factor = 1 << levels;
+    const int bottom = (factor - input.rows % factor) % factor;
+    const int right = (factor - input.cols % factor) % factor;
+    Mat source = input;
+    if ((bottom > 0) || (right > 0))
+    {
+        copyMakeBorder(input, padded, 0, bottom, 0, right, BORDER_REPLICATE);
+        source = padded;
+    }
+    resize(source, proxy, Size(source.cols >> levels, source.rows >> levels), 0, 0, INTER_AREA);
+}
+
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::collectStrip(vector<Mat> & inputs)
+{
+    const unsigned int exps = inputs.size();
+    const int rows = inputs.front().rows;
+    const int cols = inputs.front().cols;
+    const PartitionData empty = { 0, vector<double>(exps, 0), 0, 0 };
+    if (!stripCorrect)
+    {
+        stripCorrect.reset(new CameraCorrection(originalInputs));
+        stripAreas.assign(exps + 1, empty);
+        stripMin.assign(exps + 1, std::numeric_limits<PixelType>::max());
+        stripMax.assign(exps + 1, std::numeric_limits<PixelType>::lowest());
+    }
+
+    // Sums of bands are combined in order, result doesn't depend on scheduling.
+    const int bands = kernel::parallelBands(rows);
+    vector<vector<PartitionData>> partial(bands, vector<PartitionData>(exps + 1, empty));
+    vector<vector<PixelType>> partialMin(bands, stripMin), partialMax(bands, stripMax);
+    CameraCorrection & correct = *stripCorrect;
+    kernel::parallelForRows(bands,
+            [&inputs, &partial, &partialMin, &partialMax, &correct, exps, rows, cols, bands](const Range & range)
+            {
+                typedef ThresholdBasedPartitionBuilder builder_t;
+                const float t0 = builder_t::threshold(underexposure);
+                const float t1 = builder_t::threshold(overexposure);
+                vector<const PixelType *> spans(exps), run(exps);
+                vector<unsigned char> areas(cols);
+                for (int band = range.start; band < range.end; ++band)
+                {
+                    const Range bandRows(band * rows / bands, (band + 1) * rows / bands);
+                    for (unsigned int exp = 0; exp < exps; ++exp)
+                    {
+                        Mat m = inputs[exp].rowRange(bandRows);
+                        correct.preprocess(m);
+                    }
+                    for (int row = bandRows.start; row < bandRows.end; ++row)
+                    {
+                        for (unsigned int exp = 0; exp < exps; ++exp)
+                        {
+                            spans[exp] = inputs[exp].ptr<PixelType>(row);
+                        }
+                        for (int col = 0; col < cols; ++col)
+                        {
+                            areas[col] = builder_t::areaOf(spans.data(), exps, col, t0, t1);
+                        }
+                        int col = 0;
+                        while (col < cols)
+                        {
+                            // Run of pixels of one area.
+                            const unsigned char area = areas[col];
+                            int end = col + 1;
+                            while ((end < cols) && (areas[end] == area))
+                            {
+                                ++end;
+                            }
+                            for (unsigned int exp = 0; exp < exps; ++exp)
+                            {
+                                run[exp] = spans[exp] + col;
+                            }
+                            PartitionDataCollector::addSpan(partial[band][area], run.data(), exps,
+                                    end - col);
+                            // Extremes of unshifted pixels, shifted when statistics are done.
+                            const PixelType * source = run[HistogramShifter::sourceOf(area, exps)];
+                            const auto extremes = std::minmax_element(source, source + end - col);
+                            partialMin[band][area] = std::min(partialMin[band][area], *extremes.first);
+                            partialMax[band][area] = std::max(partialMax[band][area], *extremes.second);
+                            col = end;
+                        }
+                    }
+                }
+            });
+
+    for (int band = 0; band < bands; ++band)
+    {
+        for (unsigned int area = 0; area <= exps; ++area)
+        {
+            stripAreas[area].noOfPixels += partial[band][area].noOfPixels;
+            for (unsigned int exp = 0; exp < exps; ++exp)
+            {
+                stripAreas[area].avgOfAllExp[exp] += partial[band][area].avgOfAllExp[exp];
+            }
+            stripMin[area] = std::min(stripMin[area], partialMin[band][area]);
+            stripMax[area] = std::max(stripMax[area], partialMax[band][area]);
+        }
+    }
+}
+
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::finishStatistics(double & minValue, double & maxValue)
+{
+    stripPostCorrect.reset(new CameraCorrectionPost(originalInputs));
+    stripOutputCorrect.reset(new OutputCorrection());
+    stripShifts.assign(stripAreas.size(), 0);
+    PixelType lo = std::numeric_limits<PixelType>::max();
+    PixelType hi = std::numeric_limits<PixelType>::lowest();
+    for (unsigned int ident = 0; ident < stripAreas.size(); ++ident)
+    {
+        PartitionData & area = stripAreas[ident];
+        if (area.noOfPixels == 0) continue;
+        finaliseArea(ident, area, originalInputs);
+        stripShifts[ident] = HistogramShifter::shiftOf(area);
+        // Shift is monotonic, range of output is a range of shifted extremes.
+        PixelType shifted;
+        HistogramShifter::shift(&stripMin[ident], stripShifts[ident], &shifted, 1, lo, hi);
+        HistogramShifter::shift(&stripMax[ident], stripShifts[ident], &shifted, 1, lo, hi);
+    }
+    minValue = stripOutputCorrect->correct(lo);
+    maxValue = stripOutputCorrect->correct(hi);
+    debug_print(LVL_DEBUG, "Luminance of strips in [%f, %f].\n", minValue, maxValue);
+}
+
+template<typename PixelType>
+void LuminanceProcessor<PixelType>::mapStrip(Mat & output, vector<Mat> & inputs)
+{
+    const unsigned int exps = inputs.size();
+    CameraCorrection & correct = *stripCorrect;
+    CameraCorrectionPost & postCorrect = *stripPostCorrect;
+    OutputCorrection & outputCorrect = *stripOutputCorrect;
+    const vector<shift_t> & shifts = stripShifts;
+    kernel::parallelForRows(output.rows,
+            [&output, &inputs, &correct, &postCorrect, &outputCorrect, &shifts, exps](const Range & rows)
+            {
+                typedef ThresholdBasedPartitionBuilder builder_t;
+                const float t0 = builder_t::threshold(underexposure);
+                const float t1 = builder_t::threshold(overexposure);
+                vector<Mat> inputRows(exps);
+                for (unsigned int exp = 0; exp < exps; ++exp)
+                {
+                    inputRows[exp] = inputs[exp].rowRange(rows);
+                    correct.preprocess(inputRows[exp]);
+                }
+                vector<const PixelType *> spans(exps);
+                vector<unsigned char> areas(output.cols);
+                PixelType lo = std::numeric_limits<PixelType>::max();
+                PixelType hi = std::numeric_limits<PixelType>::lowest();
+                for (int row = rows.start; row < rows.end; ++row)
+                {
+                    for (unsigned int exp = 0; exp < exps; ++exp)
+                    {
+                        spans[exp] = inputs[exp].ptr<PixelType>(row);
+                    }
+                    for (int col = 0; col < output.cols; ++col)
+                    {
+                        areas[col] = builder_t::areaOf(spans.data(), exps, col, t0, t1);
+                    }
+                    PixelType * out = output.ptr<PixelType>(row);
+                    int col = 0;
+                    while (col < output.cols)
+                    {
+                        // Run of pixels of one area.
+                        const unsigned char area = areas[col];
+                        int end = col + 1;
+                        while ((end < output.cols) && (areas[end] == area))
+                        {
+                            ++end;
+                        }
+                        HistogramShifter::shift(spans[HistogramShifter::sourceOf(area, exps)] + col,
+                                shifts[area], out + col, end - col, lo, hi);
+                        col = end;
+                    }
+                }
+                for (unsigned int exp = 0; exp < exps; ++exp)
+                {
+                    postCorrect.preprocess(inputRows[exp]);
+                }
+                Mat outputRows = output.rowRange(rows);
+                outputCorrect.apply(outputRows, inputRows);
+            });
+}
+
+template class LuminanceProcessor<unsigned char> ;
+template class LuminanceProcessor<unsigned short> ;
+template class LuminanceProcessor<float> ;
+
 } /* namespace HDRCreation */
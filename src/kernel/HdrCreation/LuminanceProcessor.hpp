@@ -31,8 +31,15 @@
 #define LUMINANCEPROCESSOR_HPP_
 
 #include <opencv2/opencv.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <type_traits>
 #include <vector>
 
+#include "kernel/BufferPool.hpp"
 #include "kernel/HDRExposition.hpp"
 #include "kernel/GenericFrame.hpp"
 
@@ -43,53 +50,139 @@ template <typename T> int sgn(T val) {
     return (T(0) < val) - (val < T(0));
 }
 
+/**
+ * Frames of @param size decimated @param levels times by 2 keep at least one pixel
+ * in both dimensions.
+ */
+inline bool validProxyLevels(const cv::Size & size, unsigned int levels)
+{
+    return (levels < sizeof(int) * CHAR_BIT - 1) && ((std::min(size.width, size.height) >> levels) > 0);
+}
+
 /*
- *
+ * Luminance of HDR image from luminances of expositions, for PixelType pixels
+ * (float or fixed-point unsigned char/unsigned short).
  */
+template<typename PixelType>
 class LuminanceProcessor
 {
 protected:
+    typedef kernel::Partition<PixelType, unsigned char, unsigned int> partition_t;
+
     std::vector<kernel::GenericFramePtr> & originalInputs;
+    kernel::BufferPool & pool;
+    // Partition statistics are collected on inputs decimated by 2^proxyLevels.
+    unsigned int proxyLevels;
 
-    class CameraCorrection: public kernel::Preprocess<float>
+    /**
+     * Gamma correction, integer pixels are mapped through a table of all values.
+     */
+    class Gamma
+    {
+    private:
+        double gamma;
+        std::vector<PixelType> table;
+    public:
+        explicit Gamma(double gamma);
+        void apply(cv::Mat & m) const;
+        double operator()(double v) const;
+    };
+
+    class CameraCorrection: public kernel::Preprocess<PixelType>
     {
     private:
         std::vector<kernel::GenericFramePtr> & originalInputs;
+        Gamma gamma;
     public:
         CameraCorrection(std::vector<kernel::GenericFramePtr> & originalInputs)
-                : kernel::Preprocess<float>(), originalInputs(originalInputs)
+                : kernel::Preprocess<PixelType>(), originalInputs(originalInputs), gamma(0.7)
         { }
         virtual cv::Mat & preprocess(cv::Mat & m);
         virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs)
         { }
+        virtual bool isElementWise() const
+        {
+            return true;
+        }
     };
 
-    class CameraCorrectionPost: public kernel::Preprocess<float>
+    class CameraCorrectionPost: public kernel::Preprocess<PixelType>
     {
     private:
         std::vector<kernel::GenericFramePtr> & originalInputs;
+        Gamma gamma;
     public:
         CameraCorrectionPost(std::vector<kernel::GenericFramePtr> & originalInputs)
-                : kernel::Preprocess<float>(), originalInputs(originalInputs)
+                : kernel::Preprocess<PixelType>(), originalInputs(originalInputs), gamma(1. / 0.7)
         { }
         virtual cv::Mat & preprocess(cv::Mat & m);
         virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs)
         { }
+        virtual bool isElementWise() const
+        {
+            return true;
+        }
+    };
+
+    class OutputCorrection: public kernel::Operation<PixelType>
+    {
+    private:
+        Gamma gamma;
+    public:
+        OutputCorrection()
+                : gamma(1. / 0.7)
+        { }
+        virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs);
+        /**
+         * Corrected value of @param v, correction is monotonic.
+         */
+        double correct(double v) const
+        {
+            return gamma(v);
+        }
+        virtual bool isElementWise() const
+        {
+            return true;
+        }
     };
 
-    class ThresholdBasedPartitionBuilder: public kernel::Partition<float, unsigned char,
-            unsigned int>
+    class ThresholdBasedPartitionBuilder: public partition_t
     {
     private:
+        typedef typename partition_t::spans_t spans_t;
+
         float t0 /* underexposure threshold */, t1 /* overexposure threshold */;
-        cv::Size s;
-        void createNewThresholdArea(cv::Mat & m, cv::Mat & partitions,
-                std::vector<unsigned int> & thisPartition, unsigned int ident);
+        cv::Mat labels;
     public:
-        ThresholdBasedPartitionBuilder(cv::Size s, float t0, float t1);
+        /**
+         * Pixel value of threshold @param t given in units.
+         */
+        static float threshold(float t)
+        {
+            return t * kernel::PixelTraits<PixelType>::unit();
+        }
+        /**
+         * Area of pixel @param i: first exposition in well exposed range (@param t0, @param t1)
+         * of pixel values, blank area (number of expositions @param exps) if there isn't any.
+         */
+        static unsigned int areaOf(const PixelType * const inputs[], unsigned int exps, size_t i,
+                float t0, float t1);
+
+        /**
+         * @param labels is a buffer for labels of pixels, it is overwritten.
+         */
+        ThresholdBasedPartitionBuilder(cv::Mat labels, float t0, float t1);
 
         virtual void apply(std::vector<cv::Mat> & inputs);
         virtual cv::Mat & preprocess(cv::Mat & m);
+
+        /**
+         * Label of every pixel: area ident + 1, 0 for blank area.
+         */
+        const cv::Mat & getLabels() const
+        {
+            return labels;
+        }
     };
 
     struct PartitionData
@@ -101,27 +194,71 @@ protected:
         float evShift;
     };
 
-    class PartitionDataCollector: public kernel::LocalOperation<float, unsigned char, unsigned int>
+    /**
+     * Averages of pixels in [0, 1] from sums in @param acc of area @param ident,
+     * exposition with maximal priority and its EV are chosen.
+     */
+    static void finaliseArea(unsigned char ident, PartitionData & acc,
+            std::vector<kernel::GenericFramePtr> & originalInputs);
+
+    class PartitionDataCollector: public kernel::LocalReduction<PixelType, unsigned char,
+            unsigned int, PartitionData>
     {
     private:
         std::vector<kernel::GenericFramePtr> & originalInputs;
-        std::vector<PartitionData> data;
-
-        unsigned char ident;
     public:
-        PartitionDataCollector(kernel::Partition<float, unsigned char, unsigned int> & partitions,
+        PartitionDataCollector(partition_t & partitions,
                 std::vector<kernel::GenericFramePtr> & originalInputs);
 
-        virtual float process(float inputs[], unsigned int exps);
-        virtual void enterArea(unsigned char ident);
-        virtual void leaveArea(unsigned char ident);
+        /**
+         * Sums of @param length pixels of expositions @param inputs added to @param acc.
+         */
+        static void addSpan(PartitionData & acc, const PixelType * const inputs[],
+                unsigned int exps, size_t length);
+
+        virtual PartitionData initial(unsigned char ident);
+        virtual void accumulate(PartitionData & acc, const PixelType * const inputs[],
+                unsigned int exps, size_t length);
+        virtual void combine(PartitionData & acc, const PartitionData & other);
+        virtual void finalise(unsigned char ident, PartitionData & acc);
 
         std::vector<PartitionData> & getData();
     };
 
-    class HistogramShifter: public kernel::LocalOperation<float, unsigned char, unsigned int>
+    /**
+     * Shifts histograms of areas. Integer pixels are written at half scale,
+     * it leaves headroom for the shift. Minimum and maximum of output are collected.
+     */
+    class HistogramShifter: public kernel::LocalOperation<PixelType, unsigned char, unsigned int>
     {
-    private:
+    public:
+        // Shift in pixel units.
+        typedef typename std::conditional<std::is_integral<PixelType>::value, unsigned int,
+                float>::type shift_t;
+
+        /**
+         * Shift of area with statistics @param data.
+         */
+        static shift_t shiftOf(const PartitionData & data);
+        /**
+         * Exposition shifted in area @param ident, the blank area takes the last one.
+         */
+        static unsigned int sourceOf(unsigned int ident, unsigned int exps)
+        {
+            return std::min(ident, exps - 1);
+        }
+        /**
+         * Shifted @param length pixels of @param input to @param output, range of output
+         * extends [@param minValue, @param maxValue].
+         */
+        static void shift(const PixelType * input, shift_t areaShift, PixelType * output,
+                size_t length, PixelType & minValue, PixelType & maxValue);
+
+    protected:
+        typedef kernel::LocalOperation<PixelType, unsigned char, unsigned int> super;
+        typedef typename super::AreaState AreaState;
+        typedef typename super::AreaStatePtr AreaStatePtr;
+
 #ifndef NDEBUG
         size_t c;
 #endif
@@ -129,19 +266,119 @@ protected:
 
         // Visitor-like
         unsigned char ident;
-        float areaShift;
+        shift_t areaShift;
+        PixelType minValue, maxValue;
+
+        struct ShiftState: public AreaState
+        {
+            unsigned char ident;
+            shift_t areaShift;
+            size_t noOfPixels;
+            PixelType minValue, maxValue;
+        };
+
+        shift_t shiftOf(unsigned char ident) const;
     public:
-        HistogramShifter(kernel::Partition<float, unsigned char, unsigned int> & partitions,
-                std::vector<PartitionData> & data);
-        virtual float process(float inputs[], unsigned int exps);
+        HistogramShifter(partition_t & partitions, std::vector<PartitionData> & data);
+        virtual PixelType process(PixelType inputs[], unsigned int exps);
+        virtual void processSpan(const PixelType * const inputs[], unsigned int exps,
+                PixelType * output, size_t length);
         virtual void enterArea(unsigned char ident);
         virtual void leaveArea(unsigned char ident);
+
+        virtual bool isMergeable() const
+        {
+            return true;
+        }
+        virtual AreaStatePtr createAreaState(unsigned char ident);
+        virtual void processAreaSpan(AreaState & state, const PixelType * const inputs[],
+                unsigned int exps, PixelType * output, size_t length);
+        virtual void mergeArea(unsigned char ident, AreaState & state);
+
+        PixelType getMin() const
+        {
+            return minValue;
+        }
+        PixelType getMax() const
+        {
+            return maxValue;
+        }
     };
 
+    /**
+     * Histogram shift of full resolution pixels with areas built on a proxy
+     * (decimated by 2^levels), area of a pixel is looked up in labels of the proxy.
+     * Element-wise, tiles are streamed concurrently.
+     */
+    class ProxyHistogramShifter: public HistogramShifter
+    {
+    private:
+        typedef typename HistogramShifter::shift_t shift_t;
+
+        cv::Mat labels;
+        unsigned int levels;
+        // Exposition and shift of every label.
+        std::vector<unsigned int> expOfLabel;
+        std::vector<shift_t> shiftOfLabel;
+        boost::mutex mutex;
+    public:
+        ProxyHistogramShifter(ThresholdBasedPartitionBuilder & partitions,
+                std::vector<PartitionData> & data, unsigned int levels);
+
+        virtual void apply(cv::Mat & output, std::vector<cv::Mat> & inputs);
+        virtual bool isElementWise() const
+        {
+            return true;
+        }
+    };
+
+    typedef typename HistogramShifter::shift_t shift_t;
+
+    // Out-of-core processing, statistics of areas gathered from strips.
+    std::vector<PartitionData> stripAreas;
+    std::vector<PixelType> stripMin, stripMax;
+    std::vector<shift_t> stripShifts;
+    boost::shared_ptr<CameraCorrection> stripCorrect;
+    boost::shared_ptr<CameraCorrectionPost> stripPostCorrect;
+    boost::shared_ptr<OutputCorrection> stripOutputCorrect;
+
+    bool mapLuminanceOnProxy(cv::Mat & output, std::vector<cv::Mat> & inputs, double & minValue,
+            double & maxValue);
+
 public:
-    LuminanceProcessor(std::vector<kernel::GenericFramePtr> & originalInputs);
+    /**
+     * With @param proxyLevels > 0 areas and their statistics are computed on inputs
+     * decimated by 2^proxyLevels, only the histogram shift is done at full resolution.
+     */
+    LuminanceProcessor(std::vector<kernel::GenericFramePtr> & originalInputs,
+            kernel::BufferPool & pool, unsigned int proxyLevels = 0);
+
+    /**
+     * @param input decimated by 2^@param levels to @param proxy, which has the size of input
+     * divided by 2^levels and rounded up. Input is padded by replicated borders to
+     * a multiple of 2^levels in @param padded, so proxy pixel (r, c) is exactly the mean
+     * of the block of input pixels (r << levels, c << levels).
+     */
+    static void decimate(const cv::Mat & input, cv::Mat & proxy, unsigned int levels,
+            cv::Mat & padded);
+
+    /**
+     * Luminance of expositions @param inputs to @param output, its range is
+     * returned in @param minValue and @param maxValue.
+     */
+    bool mapLuminance(cv::Mat & output, std::vector<cv::Mat> & inputs, double & minValue,
+            double & maxValue);
 
-    bool mapLuminance(cv::Mat & output, std::vector<cv::Mat> & inputs);
+    /**
+     * Out-of-core mapping in two passes over strips of rows. Every strip of expositions
+     * is given to @method collectStrip, then @method finishStatistics returns range
+     * of output in @param minValue and @param maxValue and every strip is mapped
+     * with @method mapStrip. Result is this same as of @method mapLuminance.
+     * Inputs of strips will be overridden.
+     */
+    void collectStrip(std::vector<cv::Mat> & inputs);
+    void finishStatistics(double & minValue, double & maxValue);
+    void mapStrip(cv::Mat & output, std::vector<cv::Mat> & inputs);
 };
 
 } /* namespace kernel */
@@ -0,0 +1,121 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+
+namespace kernel
+{
+
+MappedFile::MappedFile()
+        : data(NULL), length(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string & filename, bool wholeFile)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+    {
+        void * mapping = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            data = mapping;
+            length = static_cast<size_t>(st.st_size);
+            if (wholeFile)
+            {
+                // Decoders read the file from the beginning to the end, once.
+                madvise(data, length, MADV_SEQUENTIAL);
+                madvise(data, length, MADV_WILLNEED);
+            }
+        }
+    }
+    // The mapping holds its own reference to the file.
+    ::close(fd);
+    if (!isOpen())
+    {
+        debug_print(LVL_WARNING, "Cannot map file %s.\n", filename.c_str());
+    }
+    return isOpen();
+}
+
+void MappedFile::close()
+{
+    if (isOpen())
+    {
+        munmap(data, length);
+    }
+    data = NULL;
+    length = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+    return data != NULL;
+}
+
+const unsigned char * MappedFile::bytes() const
+{
+    return static_cast<const unsigned char *>(data);
+}
+
+size_t MappedFile::size() const
+{
+    return length;
+}
+
+void MappedFile::prefetch(const std::string & filename)
+{
+#ifdef POSIX_FADV_WILLNEED
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    // Readahead is started in background, closing the file doesn't cancel it.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    ::close(fd);
+#else
+    (void) filename;
+#endif
+}
+
+} /* namespace kernel */
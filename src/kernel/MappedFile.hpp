@@ -0,0 +1,80 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef MAPPEDFILE_HPP_
+#define MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace kernel
+{
+
+/*
+ * Read-only memory mapping of a whole input file.
+ *
+ * Pages are read by the kernel as they are touched, ahead of the reader
+ * if the whole file is going to be read, so decoders work on the page cache
+ * with no buffered copy of the file.
+ */
+class MappedFile
+{
+private:
+    void * data;
+    size_t length;
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    /**
+     * Map @param filename, unmapping the previous file. False if it cannot be mapped
+     * (also for empty files). With @param wholeFile the file is read ahead from
+     * the beginning to the end, otherwise with the default readahead around
+     * touched pages.
+     */
+    bool open(const std::string & filename, bool wholeFile = true);
+    void close();
+
+    bool isOpen() const;
+    const unsigned char * bytes() const;
+    size_t size() const;
+
+    /**
+     * Ask the kernel to start reading @param filename into page cache,
+     * nothing is mapped and it returns at once.
+     */
+    static void prefetch(const std::string & filename);
+};
+
+} /* namespace kernel */
+
+#endif /* MAPPEDFILE_HPP_ */
@@ -0,0 +1,123 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include "RadianceWriter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "config.h"
+
+namespace kernel
+{
+
+namespace
+{
+
+/**
+ * Shared exponent encoding of one pixel.
+ */
+inline void toRGBE(float r, float g, float b, unsigned char * rgbe)
+{
+    const float v = std::max(r, std::max(g, b));
+    if (v < 1e-32f)
+    {
+        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+        return;
+    }
+    int e;
+    const float scale = std::frexp(v, &e) * 256.f / v;
+    rgbe[0] = (unsigned char) (std::max(r, 0.f) * scale);
+    rgbe[1] = (unsigned char) (std::max(g, 0.f) * scale);
+    rgbe[2] = (unsigned char) (std::max(b, 0.f) * scale);
+    rgbe[3] = (unsigned char) (e + 128);
+}
+
+} /* anonymous namespace */
+
+RadianceWriter::RadianceWriter()
+        : file(NULL), width(0), height(0), nextRow(0)
+{
+}
+
+RadianceWriter::~RadianceWriter()
+{
+    close();
+}
+
+bool RadianceWriter::open(const std::string & filename, int width, int height)
+{
+    close();
+    file = fopen(filename.c_str(), "wb");
+    if (file == NULL)
+    {
+        debug_print(LVL_ERROR, "Cannot open %s.\n", filename.c_str());
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    nextRow = 0;
+    scanline.resize(width * 4);
+    fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width);
+    return !ferror(file);
+}
+
+bool RadianceWriter::write(const cv::Mat & strip, int firstRow)
+{
+    if ((file == NULL) || (firstRow != nextRow) || (strip.cols != width)
+            || (firstRow + strip.rows > height) || (strip.type() != CV_32FC3))
+    {
+        debug_print(LVL_ERROR, "Strip of %d rows at %d doesn't fit.\n", strip.rows, firstRow);
+        return false;
+    }
+    cv::Mat rgb;
+    cv::cvtColor(strip, rgb, cv::COLOR_Lab2RGB);
+    for (int row = 0; row < rgb.rows; ++row)
+    {
+        const float * src = rgb.ptr<float>(row);
+        for (int col = 0; col < width; ++col, src += 3)
+        {
+            toRGBE(src[0], src[1], src[2], &scanline[col * 4]);
+        }
+        if (fwrite(scanline.data(), 1, scanline.size(), file) != scanline.size()) return false;
+    }
+    nextRow += strip.rows;
+    return true;
+}
+
+bool RadianceWriter::close()
+{
+    if (file == NULL) return false;
+    bool complete = (nextRow == height);
+    complete &= (fclose(file) == 0);
+    file = NULL;
+    return complete;
+}
+
+} /* namespace kernel */
@@ -0,0 +1,78 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef RADIANCEWRITER_HPP_
+#define RADIANCEWRITER_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace kernel
+{
+
+/*
+ * Radiance RGBE (.hdr) file written incrementally, strip by strip from the top.
+ * Whole image is never kept in memory, scanlines are stored flat (not run-length
+ * encoded), which every reader of the format accepts.
+ */
+class RadianceWriter
+{
+private:
+    FILE * file;
+    int width, height;
+    int nextRow;
+    std::vector<unsigned char> scanline;
+
+public:
+    RadianceWriter();
+    ~RadianceWriter();
+
+    /**
+     * Create @param filename and write header of @param width x @param height image.
+     */
+    bool open(const std::string & filename, int width, int height);
+
+    /**
+     * Append @param strip of CIELab pixels (CV_32FC3), its first row has to be
+     * @param firstRow, the next one after previously written strips.
+     */
+    bool write(const cv::Mat & strip, int firstRow);
+
+    /**
+     * Close file, @return true if all rows were written.
+     */
+    bool close();
+};
+
+} /* namespace kernel */
+
+#endif /* RADIANCEWRITER_HPP_ */
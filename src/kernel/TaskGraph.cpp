@@ -0,0 +1,182 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include "TaskGraph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+namespace kernel
+{
+
+TaskGraph::TaskGraph()
+{
+}
+
+TaskGraph::task_t TaskGraph::add(const std::string & name, work_t work)
+{
+    return add(name, work, dependencies_t());
+}
+
+TaskGraph::task_t TaskGraph::add(const std::string & name, work_t work, task_t dependency)
+{
+    return add(name, work, dependencies_t(1, dependency));
+}
+
+TaskGraph::task_t TaskGraph::add(const std::string & name, work_t work,
+        const dependencies_t & dependencies)
+{
+    task_t task = tasks.size();
+    std::for_each(dependencies.begin(), dependencies.end(), [this, task](task_t dependency)
+    {
+        assert(dependency < task);
+        tasks[dependency].dependents.push_back(task);
+    });
+    Task newTask =
+    { name, work, dependencies, dependencies_t(), dependencies.size(), WAITING, 0 };
+    tasks.push_back(newTask);
+    return task;
+}
+
+void TaskGraph::finish(task_t task, State state)
+{
+    tasks[task].state = state;
+    std::for_each(tasks[task].dependents.begin(), tasks[task].dependents.end(),
+            [this, state](task_t dependent)
+            {
+                if (--tasks[dependent].waitingFor > 0) return;
+                bool skip = false;
+                std::for_each(tasks[dependent].dependencies.begin(), tasks[dependent].dependencies.end(),
+                        [this, &skip](task_t dependency)
+                        {
+                            skip |= (tasks[dependency].state != DONE);
+                        });
+                if (skip)
+                {
+                    finish(dependent, SKIPPED);
+                }
+                else
+                {
+                    tasks[dependent].state = READY;
+                    ready.push_back(dependent);
+                }
+            });
+}
+
+void TaskGraph::submitReady(WorkerPool & pool, WorkerPool::Group & group)
+{
+    std::deque<task_t> toSubmit;
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        toSubmit.swap(ready);
+    }
+    std::for_each(toSubmit.begin(), toSubmit.end(), [this, &pool, &group](task_t task)
+    {
+        pool.submit(group, [this, task, &pool, &group]()
+        {
+            execute(task, pool, group);
+        });
+    });
+}
+
+void TaskGraph::execute(task_t task, WorkerPool & pool, WorkerPool::Group & group)
+{
+    std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+    bool succeeded = tasks[task].work();
+    long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now() - start).count();
+    debug_print(LVL_DEBUG, "Task %s %s in %ld ms.\n", tasks[task].name.c_str(),
+            succeeded ? "finished" : "failed", elapsed);
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        tasks[task].ms = elapsed;
+        finish(task, succeeded ? DONE : FAILED);
+    }
+    // Dependents are submitted before this job is finished, group is still pending.
+    submitReady(pool, group);
+}
+
+bool TaskGraph::run(WorkerPool & pool)
+{
+    ready.clear();
+    for (task_t task = 0; task < tasks.size(); ++task)
+    {
+        tasks[task].waitingFor = tasks[task].dependencies.size();
+        tasks[task].state = WAITING;
+        if (tasks[task].waitingFor == 0)
+        {
+            tasks[task].state = READY;
+            ready.push_back(task);
+        }
+    }
+
+    WorkerPool::Group group;
+    submitReady(pool, group);
+    pool.wait(group);
+
+    return std::all_of(tasks.begin(), tasks.end(), [](const Task & task)
+    {
+        return task.state == DONE;
+    });
+}
+
+std::string TaskGraph::describe() const
+{
+    static const char * states[] =
+    { "waiting", "ready", "done", "failed", "skipped" };
+    std::ostringstream os;
+    for (task_t task = 0; task < tasks.size(); ++task)
+    {
+        os << "  [" << task << "] " << tasks[task].name << " (" << states[tasks[task].state];
+        if ((tasks[task].state == DONE) || (tasks[task].state == FAILED))
+        {
+            os << ", " << tasks[task].ms << " ms";
+        }
+        os << ")";
+        if (!tasks[task].dependencies.empty())
+        {
+            os << " <-";
+            std::for_each(tasks[task].dependencies.begin(), tasks[task].dependencies.end(),
+                    [&os](task_t dependency)
+                    {
+                        os << " [" << dependency << "]";
+                    });
+        }
+        os << "\n";
+    }
+    return os.str();
+}
+
+} /* namespace kernel */
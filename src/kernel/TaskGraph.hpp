@@ -0,0 +1,101 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef TASKGRAPH_HPP_
+#define TASKGRAPH_HPP_
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "WorkerPool.hpp"
+
+namespace kernel
+{
+
+/*
+ * Acyclic graph of tasks. Task is run when all tasks it depends on are finished,
+ * independent tasks are run concurrently. Tasks can depend only on tasks added
+ * before them, so the graph can't have cycles.
+ *
+ * Task returns false on failure, tasks depending on it are not run then.
+ */
+class TaskGraph
+{
+public:
+    typedef size_t task_t;
+    typedef std::function<bool()> work_t;
+    typedef std::vector<task_t> dependencies_t;
+private:
+    enum State
+    {
+        WAITING, READY, DONE, FAILED, SKIPPED
+    };
+    struct Task
+    {
+        std::string name;
+        work_t work;
+        dependencies_t dependencies;
+        dependencies_t dependents;
+        size_t waitingFor;
+        State state;
+        long ms;
+    };
+    std::vector<Task> tasks;
+
+    boost::mutex mutex;
+    std::deque<task_t> ready;
+
+    void execute(task_t task, WorkerPool & pool, WorkerPool::Group & group);
+    void finish(task_t task, State state);
+    void submitReady(WorkerPool & pool, WorkerPool::Group & group);
+public:
+    TaskGraph();
+
+    task_t add(const std::string & name, work_t work);
+    task_t add(const std::string & name, work_t work, task_t dependency);
+    task_t add(const std::string & name, work_t work, const dependencies_t & dependencies);
+
+    /**
+     * Run all tasks on @param pool, returns true if all tasks succeeded.
+     */
+    bool run(WorkerPool & pool = WorkerPool::shared());
+
+    /**
+     * Tasks with their dependencies (and state and time after run), one per line.
+     */
+    std::string describe() const;
+};
+
+} /* namespace kernel */
+
+#endif /* TASKGRAPH_HPP_ */
@@ -0,0 +1,215 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+#include <boost/bind.hpp>
+
+#include "config.h"
+
+namespace kernel
+{
+
+namespace
+{
+
+// Pool and queue of the current worker thread.
+thread_local const WorkerPool * currentPool = NULL;
+thread_local size_t currentPoolQueue = 0;
+
+} /* anonymous namespace */
+
+unsigned int WorkerPool::defaultThreads = 0;
+
+WorkerPool::Group::Group()
+        : pending(0)
+{
+}
+
+WorkerPool::WorkerPool(unsigned int threads)
+        : queued(0), nextQueue(0), stopping(false)
+{
+    if (threads == 0) threads = std::max(1u, boost::thread::hardware_concurrency());
+    for (unsigned int queue = 0; queue < threads; ++queue)
+    {
+        queues.push_back(boost::shared_ptr<Queue>(new Queue()));
+    }
+    for (unsigned int queue = 1; queue < threads; ++queue)
+    {
+        workers.create_thread(boost::bind(&WorkerPool::worker, this, queue));
+    }
+    debug_print(LVL_INFO, "Worker pool of %u threads started.\n", threads);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        boost::mutex::scoped_lock lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    workers.join_all();
+}
+
+size_t WorkerPool::currentQueue() const
+{
+    return (currentPool == this) ? currentPoolQueue : 0;
+}
+
+void WorkerPool::submit(Group & group, job_t job)
+{
+    group.pending++;
+    size_t queue = currentQueue();
+    if (queue == 0)
+    {
+        // Spread jobs from outside of the pool between workers.
+        queue = nextQueue++ % queues.size();
+    }
+    {
+        // Counted before it is published, a thief can't take it before the increment.
+        boost::mutex::scoped_lock lock(sleepMutex);
+        queued++;
+    }
+    {
+        boost::mutex::scoped_lock lock(queues[queue]->mutex);
+        Job newJob =
+        { job, &group };
+        queues[queue]->jobs.push_back(newJob);
+    }
+    workAvailable.notify_one();
+}
+
+void WorkerPool::execute(Job & job)
+{
+    Group & group = *job.group;
+    std::exception_ptr error;
+    try
+    {
+        job.job();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    boost::mutex::scoped_lock lock(group.mutex);
+    if (error && !group.error) group.error = error;
+    if (--group.pending == 0) group.finished.notify_all();
+}
+
+bool WorkerPool::runOne(size_t queue)
+{
+    Job job;
+    bool found = false;
+    {
+        // Own jobs first, newest one.
+        boost::mutex::scoped_lock lock(queues[queue]->mutex);
+        if (!queues[queue]->jobs.empty())
+        {
+            job = queues[queue]->jobs.back();
+            queues[queue]->jobs.pop_back();
+            found = true;
+        }
+    }
+    for (size_t other = 1; !found && (other < queues.size()); ++other)
+    {
+        // Steal the oldest one.
+        Queue & victim = *queues[(queue + other) % queues.size()];
+        boost::mutex::scoped_lock lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+    queued--;
+    execute(job);
+    return true;
+}
+
+void WorkerPool::worker(size_t queue)
+{
+    currentPool = this;
+    currentPoolQueue = queue;
+    while (true)
+    {
+        if (runOne(queue)) continue;
+        boost::mutex::scoped_lock lock(sleepMutex);
+        while ((queued == 0) && !stopping)
+        {
+            workAvailable.wait(lock);
+        }
+        if (stopping) return;
+    }
+}
+
+void WorkerPool::wait(Group & group)
+{
+    size_t queue = currentQueue();
+    while (group.pending > 0)
+    {
+        if (runOne(queue)) continue;
+        // Jobs of this group are executed by others, the last one notifies.
+        boost::mutex::scoped_lock lock(group.mutex);
+        while (group.pending > 0)
+        {
+            group.finished.wait(lock);
+        }
+    }
+    std::exception_ptr error;
+    {
+        // Last job of the group releases its mutex before the group can be destroyed.
+        boost::mutex::scoped_lock lock(group.mutex);
+        std::swap(error, group.error);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+unsigned int WorkerPool::size() const
+{
+    return queues.size();
+}
+
+void WorkerPool::configure(unsigned int threads)
+{
+    defaultThreads = threads;
+    if (threads > 0) cv::setNumThreads(threads);
+}
+
+WorkerPool & WorkerPool::shared()
+{
+    static WorkerPool pool(defaultThreads);
+    return pool;
+}
+
+} /* namespace kernel */
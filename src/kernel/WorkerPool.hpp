@@ -0,0 +1,132 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#ifndef WORKERPOOL_HPP_
+#define WORKERPOOL_HPP_
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+namespace kernel
+{
+
+/*
+ * Fixed-size pool of worker threads with work stealing.
+ *
+ * Every worker has its own queue, jobs submitted by a worker go to its queue
+ * and are taken from its back, idle workers steal from the front of other queues.
+ * Jobs are submitted in groups, thread waiting for a group executes queued jobs
+ * in the meantime, so jobs can submit and wait for nested groups.
+ */
+class WorkerPool
+{
+public:
+    typedef std::function<void()> job_t;
+
+    /*
+     * Jobs which can be waited for together.
+     */
+    class Group
+    {
+    private:
+        friend class WorkerPool;
+        std::atomic<size_t> pending;
+        boost::mutex mutex;
+        boost::condition_variable finished;
+        // First exception thrown by a job, rethrown by wait.
+        std::exception_ptr error;
+    public:
+        Group();
+    };
+
+private:
+    struct Job
+    {
+        job_t job;
+        Group * group;
+    };
+    struct Queue
+    {
+        boost::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    // Queue 0 is for threads outside of the pool.
+    std::vector<boost::shared_ptr<Queue>> queues;
+    boost::thread_group workers;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> nextQueue;
+    std::atomic<bool> stopping;
+    boost::mutex sleepMutex;
+    boost::condition_variable workAvailable;
+
+    void worker(size_t queue);
+    size_t currentQueue() const;
+    bool runOne(size_t queue);
+    void execute(Job & job);
+
+    static unsigned int defaultThreads;
+public:
+    /**
+     * Pool of @param threads threads, calling thread counts as one of them,
+     * so threads - 1 workers are started (0 - hardware concurrency).
+     */
+    explicit WorkerPool(unsigned int threads);
+    ~WorkerPool();
+
+    void submit(Group & group, job_t job);
+    /**
+     * Wait for all jobs of @param group, queued jobs are executed while waiting.
+     * The first exception thrown by a job of the group is rethrown here,
+     * after all its jobs are finished.
+     */
+    void wait(Group & group);
+
+    /**
+     * Number of threads executing jobs, with the waiting one.
+     */
+    unsigned int size() const;
+
+    /**
+     * Size of the shared pool, has to be set before its first use.
+     * Limits OpenCV threads as well.
+     */
+    static void configure(unsigned int threads);
+    static WorkerPool & shared();
+};
+
+} /* namespace kernel */
+
+#endif /* WORKERPOOL_HPP_ */
@@ -33,7 +33,11 @@
 #include "config.h"
 #include "ProcessingEngine.hpp"
 #include "RealtimeEngine.hpp"
+#include "kernel/GenericFrame.hpp"
+#include "kernel/HdrCreation/HDRCreator.hpp"
+#include "kernel/WorkerPool.hpp"
 
+#include <cctype>
 #include <cstdlib>
 #include <getopt.h>
 #include <string>
@@ -60,7 +64,8 @@ static GlobalArgs_t globalArgs;
 
 enum
 {
-    HELP_OPTION = CHAR_MAX + 1, VERSION_OPTION
+    HELP_OPTION = CHAR_MAX + 1, VERSION_OPTION, HALF_CHROMA_OPTION, PROXY_LEVELS_OPTION,
+    STRIPS_OPTION, HALF_FLOAT_OPTION, ROLLING_WINDOW_OPTION, ALIGN_OPTION, RAW_PRESET_OPTION
 };
 
 static const struct option long_options[] =
@@ -72,6 +77,14 @@ static const struct option long_options[] =
 { "realTimeFPSInput", no_argument, NULL, 'i' },
 { "realTimeFPSOutput", no_argument, NULL, 'f' },
 { "realTimeExpPerHDR", no_argument, NULL, 'e' },
+{ "threads", required_argument, NULL, 't' },
+{ "halfChroma", no_argument, NULL, HALF_CHROMA_OPTION },
+{ "proxyLevels", required_argument, NULL, PROXY_LEVELS_OPTION },
+{ "strips", required_argument, NULL, STRIPS_OPTION },
+{ "halfFloat", no_argument, NULL, HALF_FLOAT_OPTION },
+{ "rollingWindow", no_argument, NULL, ROLLING_WINDOW_OPTION },
+{ "align", optional_argument, NULL, ALIGN_OPTION },
+{ "rawPreset", required_argument, NULL, RAW_PRESET_OPTION },
 { "verbose", no_argument, NULL, 'v' },
 { "help", no_argument, NULL, HELP_OPTION },
 { "version", no_argument, NULL, VERSION_OPTION },
@@ -96,6 +109,14 @@ static void initializeGlobalArgs()
     globalArgs.outputFile = default_output_filename;
     globalArgs.verbosity = 0;
     globalArgs.inputs = 0;
+    globalArgs.threads = 0;
+    globalArgs.halfChroma = false;
+    globalArgs.proxyLevels = 0;
+    globalArgs.strips = 0;
+    globalArgs.halfFloat = false;
+    globalArgs.rollingWindow = false; // if realTime
+    globalArgs.align = 0;
+    globalArgs.rawPreset = kernel::GenericFrame::RAW_QUALITY;
 
 }
 
@@ -103,9 +124,10 @@ static void parseArgs(int argc, char * argv[])
 {
     debug_print(LVL_DEBUG, "Parsing %d arguments.\n", argc);
     int opt, oi = -1;
+    char trailing; // after numbers of options
     while (1)
     {
-        opt = getopt_long(argc, argv, "o:clrf:i:e:vh", long_options, &oi);
+        opt = getopt_long(argc, argv, "o:clrf:i:e:t:vh", long_options, &oi);
         if (opt == -1) break;
 
         switch (opt)
@@ -138,6 +160,50 @@ static void parseArgs(int argc, char * argv[])
                 sscanf(optarg, "%u", &globalArgs.expPerHDR);
                 debug_print(LVL_INFO, "Setting real time number of expositions per HDR to %s.\n", optarg);
             break;
+            case 't':
+                sscanf(optarg, "%u", &globalArgs.threads);
+                debug_print(LVL_INFO, "Setting number of threads to %s.\n", optarg);
+            break;
+            case HALF_CHROMA_OPTION:
+                globalArgs.halfChroma = true;
+                debug_puts("Chromaticity will be merged at half resolution.\n");
+            break;
+            case PROXY_LEVELS_OPTION:
+                if (!isdigit((unsigned char) optarg[0])
+                        || (sscanf(optarg, "%u%c", &globalArgs.proxyLevels, &trailing) != 1)
+                        || (globalArgs.proxyLevels > HDRCreation::HDRCreator::maxProxyLevels))
+                {
+                    fprintf(stderr, "Proxy levels `%s` are not a number in [0, %u].\n", optarg,
+                            HDRCreation::HDRCreator::maxProxyLevels);
+                    usage(EXIT_FAILURE);
+                }
+                debug_print(LVL_INFO, "Setting luminance statistics proxy levels to %s.\n", optarg);
+            break;
+            case STRIPS_OPTION:
+                sscanf(optarg, "%u", &globalArgs.strips);
+                debug_print(LVL_INFO, "Setting rows of strips to %s.\n", optarg);
+            break;
+            case HALF_FLOAT_OPTION:
+                globalArgs.halfFloat = true;
+                debug_puts("Chromaticity will be stored as half-floats.\n");
+            break;
+            case ROLLING_WINDOW_OPTION:
+                globalArgs.rollingWindow = true;
+                debug_puts("HDR frames will be created after every exposure.\n");
+            break;
+            case ALIGN_OPTION:
+                globalArgs.align = (optarg && (strcmp(optarg, "rotation") == 0)) ? 2 : 1;
+                debug_print(LVL_INFO, "Inputs will be aligned (%s).\n",
+                        (globalArgs.align > 1) ? "translation and rotation" : "translation");
+            break;
+            case RAW_PRESET_OPTION:
+                if (!kernel::GenericFrame::rawPresetOf(optarg, globalArgs.rawPreset))
+                {
+                    fprintf(stderr, "Unknown RAW preset `%s`.\n", optarg);
+                    usage(EXIT_FAILURE);
+                }
+                debug_print(LVL_INFO, "Setting RAW preset to %s.\n", optarg);
+            break;
             case 'v':
                 fputs("Verbosity set on.\n", stdout);
                 globalArgs.verbosity = 1;
@@ -156,6 +222,17 @@ static void parseArgs(int argc, char * argv[])
         }
     }
 
+    if ((globalArgs.strips > 0) && (globalArgs.halfChroma || (globalArgs.proxyLevels > 0)))
+    {
+        fputs("--strips cannot be used with --halfChroma nor --proxyLevels.\n", stderr);
+        usage(EXIT_FAILURE);
+    }
+    if (globalArgs.halfFloat && (globalArgs.proxyLevels > 0))
+    {
+        fputs("--halfFloat cannot be used with --proxyLevels.\n", stderr);
+        usage(EXIT_FAILURE);
+    }
+
     // Input files:
     debug_print(LVL_DEBUG, "Got %d files.\n", argc - optind);
     globalArgs.inputs = argc - optind;
@@ -177,6 +254,9 @@ int main(int argc, char * argv[])
 
     verbose_print(globalArgs.verbosity, version_str, version_no);
 
+    kernel::WorkerPool::configure(globalArgs.threads);
+    verbose_print(globalArgs.verbosity, "Using %u threads.", kernel::WorkerPool::shared().size());
+
     if (globalArgs.realTime)
     {
         ui::RealtimeEngine realtimeEngine(globalArgs, globalArgs.expPerHDR);
@@ -240,6 +320,32 @@ Mandatory arguments to long options are mandatory for short options too.\n\n\
   -e, --realTimeExpPerHDR U  if in real time mode, declare how many exposures\n\
                                will be done per one HDR Image, 3 by default,\n\
                                U - is a natural number.\n\n\
+  -t, --threads N            number of threads for processing,\n\
+                               hardware concurrency by default,\n\n\
+      --halfChroma           merge chromaticity at half resolution in both\n\
+                               dimensions (4:2:0), faster and uses less memory,\n\n\
+      --proxyLevels N        compute luminance statistics on frames decimated\n\
+                               N times by 2, at most 15 and while frames keep\n\
+                               a pixel, 0 (full resolution) by default,\n\n\
+      --strips N             create HDR out-of-core in two passes over strips\n\
+                               of N rows, only inputs are kept whole, with\n\
+                               --createHDR and .hdr output it is written\n\
+                               strip by strip, 0 (whole frames) by default,\n\
+                               not with --halfChroma nor --proxyLevels,\n\n\
+      --halfFloat            store luminance and chromaticity of float inputs\n\
+                               as half-floats while merging, half of the memory\n\
+                               traffic, error at most 1/32 of a*b* unit,\n\
+                               not with --proxyLevels,\n\n\
+      --rollingWindow        if in real time mode, create HDR frame after every\n\
+                               exposure from the last U (--realTimeExpPerHDR)\n\
+                               ones, frames are decoded once,\n\n\
+      --align[=rotation]     align inputs to the middle one before HDR creation\n\
+                               (median threshold bitmaps), shift only or with\n\
+                               small rotation,\n\n\
+      --rawPreset P          RAW decoding: quality (LibRaw's default demosaic,\n\
+                               float, by default), fast (linear demosaic,\n\
+                               8-bit), half (half size, no demosaic, 8-bit) or\n\
+                               thumbnail (embedded preview, half if none),\n\n\
   -v, --verbose              increase verbosity\n\n\
       --help                 display this help and exit,\n\n\
       --version              output version information and exit.\n\
@@ -30,14 +30,17 @@
 
 #include "ProcessingEngine.hpp"
 #include "config.h"
+#include "kernel/HdrCreation/ExposureAligner.hpp"
 #include "kernel/HdrCreation/HDRCreator.hpp"
 #include "kernel/TonemappingOperators/dobrowolski15/Dobrowolski15.hpp"
 #include "kernel/GenericFrame.hpp"
+#include "kernel/MappedFile.hpp"
+#include "kernel/RadianceWriter.hpp"
+#include "kernel/WorkerPool.hpp"
 
 #include <iostream>
 #include <string>
 #include <boost/filesystem.hpp>
-#include <boost/thread.hpp>
 #include <vector>
 
 using std::string;
@@ -74,6 +77,22 @@ const boost::filesystem::path & ProcessingEngine::create_TMP()
     return temp_path;
 }
 
+void ProcessingEngine::prefetchInput(int input, int workers)
+{
+    const int next = kernel::GenericFrame::inputToReadAhead(globalArgs, input, workers);
+    if (next >= 0) kernel::MappedFile::prefetch(globalArgs.inputFiles[next]);
+}
+
+void ProcessingEngine::alignFrames(std::vector<kernel::GenericFramePtr> & frames)
+{
+    if (globalArgs.align == 0) return;
+    HDRCreation::ExposureAligner aligner(globalArgs);
+    if (!aligner.align(frames))
+    {
+        std::cout << "Inputs couldn't be aligned, they are merged as they are." << std::endl;
+    }
+}
+
 ProcessingHDRCreatorModel::ProcessingHDRCreatorModel(const GlobalArgs_t & globalArgs)
         : super(globalArgs)
 {
@@ -90,16 +109,26 @@ void ProcessingHDRCreatorModel::process()
     {
         frames.push_back(GenericFramePtr(new kernel::GenericFrame(globalArgs)));
     }
-    // Load files
-    std::vector<boost::thread *> threads;
+    // Load files, decoded RAWs are kept in buffers of the creator.
+    kernel::WorkerPool & pool = kernel::WorkerPool::shared();
+    kernel::BufferPool & buffers = creator.getBufferPool();
+    kernel::WorkerPool::Group loading;
+    // Every worker loads one input, inputs waiting for a free worker are read ahead.
+    const int ahead = pool.size();
     int i = 0;
     std::for_each(frames.begin(), frames.end(),
-            [this, &threads, &i](GenericFramePtr & frame)
+            [this, &pool, &buffers, &loading, &i, ahead](GenericFramePtr & frame)
             {
-                threads.push_back(new boost::thread(&kernel::GenericFrame::getFrameFromFile, frame, globalArgs.inputFiles[i++]));
+                const int input = i++;
+                const char * file = globalArgs.inputFiles[input];
+                pool.submit(loading, [this, frame, file, input, ahead, &buffers]()
+                {
+                    prefetchInput(input, ahead);
+                    frame->getFrameFromFile(file, &buffers);
+                });
             });
-    std::for_each(threads.begin(), threads.end(), [](boost::thread* t)
-    {   t->join(); delete t;});
+    pool.wait(loading);
+    alignFrames(frames);
 
     GenericFramePtr hdrImage(new kernel::GenericFrame(globalArgs));
 #ifndef NDEBUG
@@ -116,6 +145,34 @@ void ProcessingHDRCreatorModel::process()
     });
 #endif
 
+    const string outputFile(globalArgs.outputFile);
+    if ((globalArgs.strips > 0) && (outputFile.size() > 4)
+            && (outputFile.compare(outputFile.size() - 4, 4, ".hdr") == 0))
+    {
+        // Out-of-core, output is written strip by strip.
+        cv::Size size = frames.front()->getRawFrame().size();
+        kernel::RadianceWriter writer;
+        bool written = creator.createInStrips(frames,
+                [&writer, &outputFile, &size](const cv::Mat & strip, int firstRow)
+                {
+                    // File is created once inputs are accepted.
+                    if ((firstRow == 0) && !writer.open(outputFile, size.width, size.height))
+                    {
+                        return false;
+                    }
+                    return writer.write(strip, firstRow);
+                });
+        if (writer.close() && written)
+        {
+            std::cout << "File saved to " << globalArgs.outputFile << std::endl;
+        }
+        else
+        {
+            std::cout << "Cannot save file to " << globalArgs.outputFile << std::endl;
+        }
+        return;
+    }
+
     if (creator.create(hdrImage, frames) && hdrImage != 0 && hdrImage->isValid())
     {
 #ifndef NDEBUG
@@ -207,16 +264,26 @@ void ProcessingHDRCreatorAndToneMapper::process()
         frames.push_back(GenericFramePtr(new kernel::GenericFrame(globalArgs)));
     }
 
-    // Load files
-    std::vector<boost::thread *> threads;
+    // Load files, decoded RAWs are kept in buffers of the creator.
+    kernel::WorkerPool & pool = kernel::WorkerPool::shared();
+    kernel::BufferPool & buffers = creator.getBufferPool();
+    kernel::WorkerPool::Group loading;
+    // Every worker loads one input, inputs waiting for a free worker are read ahead.
+    const int ahead = pool.size();
     int i = 0;
     std::for_each(frames.begin(), frames.end(),
-            [this, &threads, &i](GenericFramePtr & frame)
+            [this, &pool, &buffers, &loading, &i, ahead](GenericFramePtr & frame)
             {
-                threads.push_back(new boost::thread(&kernel::GenericFrame::getFrameFromFile, frame, globalArgs.inputFiles[i++]));
+                const int input = i++;
+                const char * file = globalArgs.inputFiles[input];
+                pool.submit(loading, [this, frame, file, input, ahead, &buffers]()
+                {
+                    prefetchInput(input, ahead);
+                    frame->getFrameFromFile(file, &buffers);
+                });
             });
-    std::for_each(threads.begin(), threads.end(), [](boost::thread* t)
-    {   t->join(); delete t;});
+    pool.wait(loading);
+    alignFrames(frames);
 
     GenericFramePtr hdrImage(new kernel::GenericFrame(globalArgs));
     /** CREATE HDR */
@@ -32,8 +32,10 @@
 #define PROCESSINGENGINE_H_
 
 #include "config.h"
+#include "kernel/GenericFrame.hpp"
 #include <boost/filesystem.hpp>
 #include <string>
+#include <vector>
 using std::string;
 
 namespace ui
@@ -53,6 +55,17 @@ protected:
 
     const boost::filesystem::path & create_TMP();
 
+    /**
+     * Start reading the input file waiting for a free worker, while input @param input
+     * is loaded by one of @param workers, into page cache.
+     */
+    void prefetchInput(int input, int workers);
+
+    /**
+     * Align loaded @param frames in place if globalArgs.align is set.
+     */
+    void alignFrames(std::vector<kernel::GenericFramePtr> & frames);
+
 public:
     explicit ProcessingEngine(const GlobalArgs_t & globalArgs);
     virtual ~ProcessingEngine();
@@ -58,7 +58,8 @@ namespace ui
 
 RealtimeEngine::RealtimeEngine(const GlobalArgs_t & globalArgs, int exposuresPerHDR)
         : createOutput(globalArgs.outputFile != NULL), hdrCreator(globalArgs), tmo(globalArgs), exposuresPerHDR(
-                exposuresPerHDR), semSwitch(0), semCapture(0), fps(globalArgs.inputFPS), exposureCompensactionRange(
+                exposuresPerHDR), semSwitch(0), semCapture(0), rollingWindow(globalArgs.rollingWindow), nextExposure(
+                0), window(exposuresPerHDR), fps(globalArgs.inputFPS), exposureCompensactionRange(
                 1), initializedOnlyGenericDevice(true), globalArgs(globalArgs)
 {
     using kernel::GenericFramePtr;
@@ -77,7 +78,9 @@ RealtimeEngine::RealtimeEngine(const GlobalArgs_t & globalArgs, int exposuresPer
     work = vectorOfFramePtrsPtr_t(new std::vector<kernel::GenericFramePtr>());
     buffer = vectorOfFramePtrsPtr_t(new std::vector<kernel::GenericFramePtr>());
 
-    for (int i = 0; i < exposuresPerHDR; ++i)
+    // Every HDR frame is created from fresh exposures or after each one.
+    const int capturedPerHDR = rollingWindow ? 1 : exposuresPerHDR;
+    for (int i = 0; i < capturedPerHDR; ++i)
     {
         work->push_back(GenericFramePtr(new GenericFrame(globalArgs)));
         buffer->push_back(GenericFramePtr(new GenericFrame(globalArgs)));
@@ -205,7 +208,7 @@ void RealtimeEngine::videoCapturer()
             return;
         }
         // capture
-        int expNo = 0;
+        int expNo = rollingWindow ? nextExposure : 0;
         for (auto it = buffer->begin(); it != buffer->end(); it++, expNo++)
         {
             kernel::GenericFramePtr frame = *it;
@@ -232,6 +235,7 @@ void RealtimeEngine::videoCapturer()
                 return;
             }
         }
+        if (rollingWindow) nextExposure = expNo % exposuresPerHDR;
         debug_puts("Video capturer is unlocking 1\n");
         semSwitch.post();
         // All exposures capture time.
@@ -258,6 +262,7 @@ void RealtimeEngine::creator()
     GenericFramePtr hdrImage(new kernel::GenericFrame(globalArgs));
     GenericFramePtr ldrImage(new kernel::GenericFrame(globalArgs));
     cv::Mat resized;
+    unsigned int slot = 0; // of the window, exposures come in order of capture
 
     while (!quit)
     {
@@ -273,10 +278,23 @@ void RealtimeEngine::creator()
         tmp = work;
         work = buffer;
         buffer = tmp;
+        if (rollingWindow)
+        {
+            // Captured frame replaces the previous one of its exposure, the creator
+            // recognises the others and reuses their decoded planes.
+            window[slot] = work->front();
+            slot = (slot + 1) % exposuresPerHDR;
+            work->front() = GenericFramePtr(new kernel::GenericFrame(globalArgs));
+        }
         debug_puts("Creator is unlocking 0\n");
         semCapture.post();
 
-        if (!hdrCreator.create(hdrImage, *work) || hdrImage == 0 || !hdrImage->isValid())
+        if (rollingWindow && std::count(window.begin(), window.end(), GenericFramePtr()) > 0)
+        {
+            continue; // Not every exposure captured yet.
+        }
+        std::vector<GenericFramePtr> & frames = rollingWindow ? window : *work;
+        if (!hdrCreator.create(hdrImage, frames) || hdrImage == 0 || !hdrImage->isValid())
         {
             debug_print(LVL_DEBUG, "Waiting for %d ms for device to start (HDR).\n", 1000);
             boost::this_thread::sleep_for(boost::chrono::seconds(1));
@@ -319,7 +337,8 @@ void RealtimeEngine::creator()
                         cv::Size(800, (int) ((float) 800 / aspect)), 0, 0, cv::INTER_NEAREST);
                 char buf[128] = "";
                 sprintf(buf, "Scalled. Frame %d.",
-                        ((int) videoCapture.get(cv::CAP_PROP_FRAME_COUNT)) / exposuresPerHDR);
+                        ((int) videoCapture.get(cv::CAP_PROP_FRAME_COUNT))
+                                / (rollingWindow ? 1 : exposuresPerHDR));
                 cv::putText(resized, buf, cvPoint(30, 30), cv::FONT_HERSHEY_COMPLEX_SMALL, 0.8,
                         cvScalar(200, 200, 250), 1, CV_AA);
                 cv::imshow(windowOriginalLabel, resized);
@@ -67,6 +67,12 @@ private:
     vectorOfFramePtrsPtr_t buffer;
     vectorOfFramePtrsPtr_t work;
 
+    // With globalArgs.rollingWindow one exposure is captured at a time, settings
+    // go round, the window keeps the last frame of every exposure.
+    bool rollingWindow;
+    unsigned int nextExposure;
+    std::vector<kernel::GenericFramePtr> window;
+
     bool quit;
 
     float fps;
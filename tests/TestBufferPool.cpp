@@ -0,0 +1,126 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "kernel/BufferPool.hpp"
+
+using namespace kernel;
+using namespace cv;
+
+TEST(BufferPoolCase, ReleasedBufferIsReused)
+{
+    BufferPool pool;
+    uchar * data;
+    {
+        Mat m = pool.get(37, 53, CV_32FC2);
+        data = m.data;
+    }
+    Mat m = pool.get(37, 53, CV_32FC2);
+    EXPECT_EQ(data, m.data);
+    EXPECT_EQ(1u, pool.getAllocations());
+    EXPECT_EQ(1u, pool.getReuses());
+}
+
+TEST(BufferPoolCase, ReferencedBufferIsNotReused)
+{
+    BufferPool pool;
+    Mat first = pool.get(37, 53, CV_8U);
+    Mat second = pool.get(37, 53, CV_8U);
+    EXPECT_NE(first.data, second.data);
+    EXPECT_EQ(2u, pool.getAllocations());
+    EXPECT_EQ(0u, pool.getReuses());
+
+    // Other type is other key.
+    Mat third = pool.get(37, 53, CV_16U);
+    EXPECT_EQ(3u, pool.getAllocations());
+}
+
+TEST(BufferPoolCase, SteadyStateDoesNotAllocate)
+{
+    BufferPool pool;
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        Mat luminance = pool.get(Size(53, 37), CV_32F);
+        Mat color = pool.get(Size(53, 37), CV_32FC2);
+        Mat output = pool.get(Size(53, 37), CV_32FC3);
+    }
+    EXPECT_EQ(3u, pool.getAllocations());
+    EXPECT_EQ(27u, pool.getReuses());
+    EXPECT_EQ(3u, pool.size());
+}
+
+TEST(BufferPoolCase, AlternatingSizesDoNotAllocate)
+{
+    // Full size and proxy / strip sized buffers used by turns.
+    BufferPool pool;
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        {
+            Mat full = pool.get(Size(53, 37), CV_32F);
+        }
+        {
+            Mat proxy = pool.get(Size(14, 10), CV_32F);
+            Mat half = pool.get(Size(27, 37), CV_32FC2);
+        }
+    }
+    EXPECT_EQ(3u, pool.getAllocations());
+    EXPECT_EQ(27u, pool.getReuses());
+    EXPECT_EQ(3u, pool.size());
+}
+
+TEST(BufferPoolCase, LeastRecentlyUsedFreeBuffersAreReleased)
+{
+    BufferPool pool(2);
+    Mat held = pool.get(37, 53, CV_8U);
+    {
+        Mat m = pool.get(37, 53, CV_32F);
+    }
+    {
+        Mat m = pool.get(74, 106, CV_32F);
+    }
+    {
+        // 37x53 one is used again, 74x106 is the least recently used.
+        Mat m = pool.get(37, 53, CV_32F);
+    }
+    Mat m = pool.get(10, 10, CV_32F);
+    // Least recently used free buffer is released, the held one stays.
+    EXPECT_EQ(3u, pool.size());
+    {
+        Mat again = pool.get(37, 53, CV_32F);
+    }
+    EXPECT_EQ(4u, pool.getAllocations());
+    pool.trim();
+    EXPECT_EQ(2u, pool.size());
+    held.release();
+    m.release();
+    pool.trim();
+    EXPECT_EQ(0u, pool.size());
+}
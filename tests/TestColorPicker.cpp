@@ -0,0 +1,131 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <vector>
+
+#include "kernel/HdrCreation/ColorPicker.hpp"
+
+using namespace HDRCreation;
+using namespace cv;
+
+namespace
+{
+
+/**
+ * Random luminances and chromaticities of @param exps expositions, @param length pixels.
+ * Every 7th pixel is a tie between first two expositions.
+ */
+template<typename PixelType, typename ChromaticityMatType>
+struct Spans
+{
+    std::vector<std::vector<PixelType>> luminances;
+    std::vector<std::vector<ChromaticityMatType>> chroma;
+    std::vector<const PixelType *> luminancePtrs;
+    std::vector<const ChromaticityMatType *> chromaPtrs;
+
+    Spans(unsigned int exps, size_t length, float unit, float chromaRange)
+            : luminances(exps, std::vector<PixelType>(length)), chroma(exps,
+                    std::vector<ChromaticityMatType>(length))
+    {
+        std::mt19937 generator(exps * 1000 + length);
+        std::uniform_real_distribution<float> luminance(0, unit);
+        std::uniform_real_distribution<float> color(0, chromaRange);
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            for (size_t i = 0; i < length; ++i)
+            {
+                luminances[exp][i] = luminance(generator);
+                chroma[exp][i] = ChromaticityMatType(color(generator), color(generator));
+            }
+            luminancePtrs.push_back(luminances[exp].data());
+            chromaPtrs.push_back(chroma[exp].data());
+        }
+        for (size_t i = 0; i < length && exps > 1; i += 7)
+        {
+            luminances[1][i] = luminances[0][i];
+        }
+    }
+};
+
+template<typename PixelType, typename ChromaticityMatType>
+void expectVectorEqualsScalar(float unit, float chromaRange)
+{
+    typedef ColorPicker<PixelType, ChromaticityMatType> picker_t;
+    const size_t lengths[] = { 1, 15, 16, 17, 100, 1001 };
+    for (unsigned int exps = 1; exps <= 6; ++exps)
+    {
+        for (size_t length : lengths)
+        {
+            Spans<PixelType, ChromaticityMatType> spans(exps, length, unit, chromaRange);
+            std::vector<ChromaticityMatType> expected(length), picked(length);
+            picker_t::pickScalar(spans.luminancePtrs.data(), spans.chromaPtrs.data(), exps,
+                    expected.data(), 0, length);
+            picker_t::pick(spans.luminancePtrs.data(), spans.chromaPtrs.data(), exps,
+                    picked.data(), length);
+            for (size_t i = 0; i < length; ++i)
+            {
+                ASSERT_EQ(expected[i][0], picked[i][0]) << exps << " exps, pixel " << i;
+                ASSERT_EQ(expected[i][1], picked[i][1]) << exps << " exps, pixel " << i;
+            }
+        }
+    }
+}
+
+}
+
+TEST(ColorPickerCase, PicksBestExposed)
+{
+    const float luminances[3][2] = { { 0.1f, 0.45f }, { 0.55f, 0.9f }, { 0.98f, 0.5f } };
+    const Vec2f chroma[3][2] = { { Vec2f(1, 1), Vec2f(2, 2) }, { Vec2f(3, 3), Vec2f(4, 4) },
+            { Vec2f(5, 5), Vec2f(6, 6) } };
+    const float * luminancePtrs[3] = { luminances[0], luminances[1], luminances[2] };
+    const Vec2f * chromaPtrs[3] = { chroma[0], chroma[1], chroma[2] };
+    Vec2f output[2];
+    ColorPicker<float, Vec2f>::pick(luminancePtrs, chromaPtrs, 3, output, 2);
+    EXPECT_EQ(3, output[0][0]);
+    EXPECT_EQ(6, output[1][1]);
+}
+
+TEST(ColorPickerCase, FloatVectorEqualsScalar)
+{
+    expectVectorEqualsScalar<float, Vec2f>(1, 200);
+}
+
+TEST(ColorPickerCase, FixedPointVectorEqualsScalar)
+{
+    expectVectorEqualsScalar<unsigned short, Vec2b>(65535, 255);
+}
+
+TEST(ColorPickerCase, HalfVectorEqualsScalar)
+{
+    expectVectorEqualsScalar<float, kernel::Vec2h>(1, 200);
+}
@@ -0,0 +1,122 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "kernel/HdrCreation/ExposureAligner.hpp"
+#include "testArgs.hpp"
+
+using namespace HDRCreation;
+using namespace cv;
+
+namespace
+{
+
+/**
+ * Smooth random texture of @param size.
+ */
+Mat scene(const Size & size)
+{
+    Mat noise(size, CV_8U), smooth;
+    theRNG().state = 20;
+    randu(noise, Scalar::all(0), Scalar::all(256));
+    GaussianBlur(noise, smooth, Size(0, 0), 3);
+    normalize(smooth, smooth, 0, 255, NORM_MINMAX);
+    return smooth;
+}
+
+/**
+ * @param image moved by @param shift (content at p goes to p + shift) with exposure
+ * changed by @param gain.
+ */
+Mat exposed(const Mat & image, const Point & shift, double gain)
+{
+    Mat map = (Mat_<double>(2, 3) << 1, 0, shift.x, 0, 1, shift.y);
+    Mat moved, result;
+    warpAffine(image, moved, map, image.size(), INTER_NEAREST, BORDER_REPLICATE);
+    moved.convertTo(result, -1, gain);
+    return result;
+}
+
+}
+
+TEST(ExposureAlignerCase, Levels)
+{
+    EXPECT_EQ(1, ExposureAligner::levelsFor(Size(40, 40)));
+    EXPECT_EQ(2, ExposureAligner::levelsFor(Size(64, 100)));
+    EXPECT_EQ(ExposureAligner::maxLevels, ExposureAligner::levelsFor(Size(4000, 3000)));
+}
+
+TEST(ExposureAlignerCase, FindsShiftOfDifferentExposure)
+{
+    const Mat reference = scene(Size(320, 240));
+    const int levels = ExposureAligner::levelsFor(reference.size());
+    const ExposureAligner::Pyramid referencePyramid = ExposureAligner::pyramidOf(reference, levels);
+    const Point shifts[] = { Point(0, 0), Point(7, -4), Point(-13, 9), Point(1, 1) };
+    for (const Point & shift : shifts)
+    {
+        const ExposureAligner::Pyramid moving = ExposureAligner::pyramidOf(
+                exposed(reference, shift, 0.6), levels);
+        EXPECT_EQ(shift, ExposureAligner::shiftOf(referencePyramid, moving,
+                Rect(Point(0, 0), reference.size())));
+    }
+}
+
+TEST(ExposureAlignerCase, AlignsFramesToMiddle)
+{
+    GlobalArgs_t args = testArgs(false, "", 0, NULL);
+    args.align = 1;
+    const Mat gray = scene(Size(256, 192));
+    std::vector<kernel::GenericFramePtr> frames;
+    const Point shifts[] = { Point(3, -2), Point(0, 0), Point(-5, 4) };
+    const double gains[] = { 0.5, 1, 1.5 };
+    for (int exp = 0; exp < 3; ++exp)
+    {
+        Mat bgr;
+        cvtColor(exposed(gray, shifts[exp], gains[exp]), bgr, COLOR_GRAY2BGR);
+        frames.push_back(kernel::GenericFramePtr(
+                new kernel::GenericFrame(args, bgr, kernel::GenericFrame::COLOR_BGR)));
+    }
+    ExposureAligner aligner(args);
+    ASSERT_TRUE(aligner.align(frames));
+
+    // Away from replicated borders every exposition matches the middle one.
+    const Rect inner(16, 16, 256 - 32, 192 - 32);
+    Mat middle;
+    cvtColor(frames[1]->getRawFrame(), middle, COLOR_BGR2GRAY);
+    for (int exp = 0; exp < 3; ++exp)
+    {
+        Mat aligned, expected;
+        cvtColor(frames[exp]->getRawFrame(), aligned, COLOR_BGR2GRAY);
+        middle.convertTo(expected, -1, gains[exp]);
+        EXPECT_LE(norm(aligned(inner), expected(inner), NORM_INF), 2) << exp;
+    }
+}
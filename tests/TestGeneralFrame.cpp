@@ -29,6 +29,7 @@
  */
 #include <gtest/gtest.h>
 #include <boost/assert.hpp>
+#include <cstdio>
 #include <iostream>
 #include <opencv2/opencv.hpp>
 
@@ -64,6 +65,68 @@ TEST_F(FrameTestCase, FrameCreateNew)
     ASSERT_FALSE(frame.empty());
 }
 
+TEST(FrameCase, LabDepthKeepsColors)
+{
+    // 8-bit Lab is L * 255 / 100 and a*b* + 128, float Lab is plain.
+    Mat lab8(1, 2, CV_8UC3);
+    lab8.at<Vec3b>(0, 0) = Vec3b(255, 128, 0);
+    lab8.at<Vec3b>(0, 1) = Vec3b(51, 200, 100);
+    GenericFrame gf(argsHDR, lab8, GenericFrame::COLOR_CIELab);
+    ASSERT_TRUE(gf.convertToDepth(CV_32FC3));
+    const Mat & lab = gf.getRawFrame();
+    ASSERT_EQ(CV_32FC3, lab.type());
+    EXPECT_NEAR(100, lab.at<Vec3f>(0, 0)[0], 1e-4);
+    EXPECT_NEAR(0, lab.at<Vec3f>(0, 0)[1], 1e-4);
+    EXPECT_NEAR(-128, lab.at<Vec3f>(0, 0)[2], 1e-4);
+    EXPECT_NEAR(20, lab.at<Vec3f>(0, 1)[0], 1e-4);
+    EXPECT_NEAR(72, lab.at<Vec3f>(0, 1)[1], 1e-4);
+    EXPECT_NEAR(-28, lab.at<Vec3f>(0, 1)[2], 1e-4);
+
+    ASSERT_TRUE(gf.convertToDepth(CV_8UC3));
+    EXPECT_EQ(0, norm(gf.getRawFrame(), lab8, NORM_INF));
+}
+
+TEST(FrameCase, FilesOfMemoryAndFileDecodersAreRead)
+{
+    // PNG is decoded from the mapping of the file, Radiance from its path.
+    Mat image(8, 12, CV_32FC3);
+    randu(image, Scalar::all(0.1), Scalar::all(4));
+    Mat image8;
+    image.convertTo(image8, CV_8UC3, 60);
+    const std::string png = "/tmp/GenericFrameTest.png", hdr = "/tmp/GenericFrameTest.hdr";
+    ASSERT_TRUE(imwrite(png, image8));
+    ASSERT_TRUE(imwrite(hdr, image));
+
+    GenericFrame fromMemory(argsHDR);
+    ASSERT_TRUE(fromMemory.getFrameFromFile(png));
+    EXPECT_EQ(0, norm(fromMemory.getRawFrame(), image8, NORM_INF));
+
+    GenericFrame fromFile(argsHDR);
+    ASSERT_TRUE(fromFile.getFrameFromFile(hdr));
+    ASSERT_EQ(CV_32FC3, fromFile.getRawFrame().type());
+    // RGBE keeps 8 bits of mantissa.
+    EXPECT_LE(norm(fromFile.getRawFrame(), image, NORM_INF), 4. / 128);
+    remove(png.c_str());
+    remove(hdr.c_str());
+}
+
+TEST(FrameCase, ReadAheadOnlyInputsWaitingForWorker)
+{
+    GlobalArgs_t args = testArgs(true, "", 10, NULL);
+    // Inputs 0-3 are loaded by 4 workers at first, each reads ahead the one after
+    // the loaded ones.
+    EXPECT_EQ(4, GenericFrame::inputToReadAhead(args, 0, 4));
+    EXPECT_EQ(9, GenericFrame::inputToReadAhead(args, 5, 4));
+    EXPECT_EQ(-1, GenericFrame::inputToReadAhead(args, 6, 4));
+    EXPECT_EQ(-1, GenericFrame::inputToReadAhead(args, 9, 4));
+    EXPECT_EQ(1, GenericFrame::inputToReadAhead(args, 0, 1));
+    EXPECT_TRUE(GenericFrame::readsWholeFiles(args));
+
+    args.rawPreset = GenericFrame::RAW_THUMBNAIL;
+    EXPECT_FALSE(GenericFrame::readsWholeFiles(args));
+    EXPECT_EQ(-1, GenericFrame::inputToReadAhead(args, 0, 4));
+}
+
 TEST(ExposureValueCase, TestShutterSpeedChange)
 {
     double eps = 0.1;
@@ -0,0 +1,313 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "kernel/HdrCreation/HDRCreator.hpp"
+#include "testArgs.hpp"
+
+using namespace HDRCreation;
+using namespace cv;
+
+namespace
+{
+
+/**
+ * Bracket of expositions (3 by default, with @param gains) of a smooth random color scene
+ * of @param size, in BGR of @param depth (CV_8U or CV_32F).
+ */
+std::vector<kernel::GenericFramePtr> bracket(const GlobalArgs_t & args, const Size & size,
+        int depth, const std::vector<double> & gains = { 0.25, 1, 4 })
+{
+    Mat noise(size, CV_32FC3), scene;
+    theRNG().state = 20;
+    randu(noise, Scalar::all(0), Scalar::all(1));
+    GaussianBlur(noise, scene, Size(0, 0), 2);
+    normalize(scene, scene, 0.02, 1, NORM_MINMAX);
+    std::vector<kernel::GenericFramePtr> frames;
+    for (double gain : gains)
+    {
+        Mat exposed;
+        scene.convertTo(exposed, CV_MAKETYPE(depth, 3), (depth == CV_8U) ? 255 * gain : gain);
+        if (depth != CV_8U) exposed = cv::min(exposed, 1.);
+        frames.push_back(kernel::GenericFramePtr(
+                new kernel::GenericFrame(args, exposed, kernel::GenericFrame::COLOR_BGR)));
+    }
+    return frames;
+}
+
+HDRCreator::strip_sink_t ignoredStrips()
+{
+    return [](const Mat &, int)
+    {
+        return true;
+    };
+}
+
+/**
+ * Largest difference of channels of @param a and @param b.
+ */
+double maxDifference(const Mat & a, const Mat & b)
+{
+    Mat difference;
+    absdiff(a, b, difference);
+    double maxValue = 0;
+    minMaxLoc(difference.reshape(1), NULL, &maxValue);
+    return maxValue;
+}
+
+}
+
+TEST(HDRCreatorCase, StripsMatchWholeFrame)
+{
+    // Strips differ from the whole frame only in the order of summation of statistics.
+    const double tolerance = 0.01;
+    const int depths[] = { CV_8U, CV_32F };
+    const int heights[] = { 7, 16, 48, 100 };
+    for (int depth : depths)
+    {
+        GlobalArgs_t args = testArgs(true, "", 0, NULL);
+        std::vector<kernel::GenericFramePtr> frames = bracket(args, Size(64, 48), depth);
+        kernel::GenericFramePtr whole(new kernel::GenericFrame(args));
+        HDRCreator creator(args);
+        ASSERT_TRUE(creator.create(whole, frames));
+        for (int stripRows : heights)
+        {
+            args.strips = stripRows;
+            HDRCreator stripCreator(args);
+            frames = bracket(args, Size(64, 48), depth);
+            Mat output(48, 64, CV_32FC3, Scalar::all(-1));
+            int rows = 0;
+            ASSERT_TRUE(stripCreator.createInStrips(frames, [&output, &rows](const Mat & strip, int firstRow)
+            {
+                Mat target = output.rowRange(firstRow, firstRow + strip.rows);
+                strip.copyTo(target);
+                rows += strip.rows;
+                return true;
+            }));
+            EXPECT_EQ(48, rows) << stripRows;
+            EXPECT_LE(maxDifference(whole->getRawFrame(), output), tolerance)
+                    << "depth " << depth << ", strips of " << stripRows << " rows";
+        }
+    }
+}
+
+TEST(HDRCreatorCase, InputsOfOtherSizeAreRejected)
+{
+    GlobalArgs_t args = testArgs(true, "", 0, NULL);
+    std::vector<kernel::GenericFramePtr> frames = bracket(args, Size(64, 48), CV_8U);
+    std::vector<kernel::GenericFramePtr> other = bracket(args, Size(64, 40), CV_8U);
+    frames[2] = other[2];
+    HDRCreator creator(args);
+    EXPECT_FALSE(creator.create(kernel::GenericFramePtr(new kernel::GenericFrame(args)), frames));
+    EXPECT_FALSE(creator.createInStrips(frames, ignoredStrips()));
+}
+
+TEST(HDRCreatorCase, InvalidInputsAreRejected)
+{
+    GlobalArgs_t args = testArgs(true, "", 0, NULL);
+    args.strips = 16;
+    std::vector<kernel::GenericFramePtr> frames = bracket(args, Size(64, 48), CV_8U);
+    Mat empty;
+    frames[1] = kernel::GenericFramePtr(
+            new kernel::GenericFrame(args, empty, kernel::GenericFrame::COLOR_BGR));
+    HDRCreator creator(args);
+    EXPECT_FALSE(creator.createInStrips(frames, ignoredStrips()));
+    frames[1].reset();
+    EXPECT_FALSE(creator.createInStrips(frames, ignoredStrips()));
+}
+
+TEST(HDRCreatorCase, StripsAreNotMergedAtHalfResolution)
+{
+    GlobalArgs_t args = testArgs(true, "", 0, NULL);
+    args.strips = 16;
+    std::vector<kernel::GenericFramePtr> frames = bracket(args, Size(64, 48), CV_8U);
+    HDRCreator creator(args);
+    EXPECT_TRUE(creator.createInStrips(frames, ignoredStrips()));
+    args.halfChroma = true;
+    HDRCreator halfChroma(args);
+    EXPECT_FALSE(halfChroma.createInStrips(frames, ignoredStrips()));
+}
+
+/**
+ * Merge with L and a*b* in half-floats against the float one on the same bracket,
+ * at full and half resolution of chromaticity. Mean difference of Lab is bounded,
+ * maximal one is recorded: pixels at borders of luminance areas may change area.
+ */
+TEST(HDRCreatorCase, HalfFloatIsCloseToFloat)
+{
+    for (bool halfChroma : { false, true })
+    {
+        GlobalArgs_t args = testArgs(true, "", 0, NULL);
+        args.halfChroma = halfChroma;
+        std::vector<kernel::GenericFramePtr> frames = bracket(args, Size(96, 64), CV_32F);
+        kernel::GenericFramePtr single(new kernel::GenericFrame(args));
+        HDRCreator creator(args);
+        ASSERT_TRUE(creator.create(single, frames));
+
+        args.halfFloat = true;
+        frames = bracket(args, Size(96, 64), CV_32F);
+        kernel::GenericFramePtr half(new kernel::GenericFrame(args));
+        HDRCreator halfCreator(args);
+        ASSERT_TRUE(halfCreator.create(half, frames));
+
+        Mat difference;
+        absdiff(single->getRawFrame(), half->getRawFrame(), difference);
+        std::vector<Mat> channels;
+        split(difference, channels);
+        const char * names[] = { "L", "a", "b" };
+        for (int ch = 0; ch < 3; ++ch)
+        {
+            double maxDifference = 0;
+            minMaxLoc(channels[ch], NULL, &maxDifference);
+            const double meanDifference = mean(channels[ch])[0];
+            const std::string name = std::string(halfChroma ? "halfChroma" : "fullChroma") + names[ch];
+            RecordProperty(name + "MaxDifference", std::to_string(maxDifference));
+            RecordProperty(name + "MeanDifference", std::to_string(meanDifference));
+            EXPECT_LT(meanDifference, 0.5) << name;
+        }
+    }
+}
+
+TEST(HDRCreatorCase, RollingWindowMatchesFreshMerge)
+{
+    // Second window shares two frames with the first one, their planes are reused.
+    // Luminance is processed in place, reused planes have to be copies.
+    const int depths[] = { CV_8U, CV_32F };
+    for (int depth : depths)
+    {
+        GlobalArgs_t args = testArgs(true, "", 0, NULL);
+        args.rollingWindow = true;
+        std::vector<kernel::GenericFramePtr> frames = bracket(args, Size(64, 48), depth,
+                { 0.25, 1, 4, 16 });
+        std::vector<kernel::GenericFramePtr> first(frames.begin(), frames.begin() + 3);
+        std::vector<kernel::GenericFramePtr> second(frames.begin() + 1, frames.end());
+        HDRCreator creator(args);
+        kernel::GenericFramePtr output(new kernel::GenericFrame(args));
+        ASSERT_TRUE(creator.create(output, first));
+        testing::internal::CaptureStdout();
+        ASSERT_TRUE(creator.create(output, second));
+        EXPECT_NE(std::string::npos, testing::internal::GetCapturedStdout().find(
+                "2 of 3 frame(s) of the window decoded before"));
+
+        std::vector<kernel::GenericFramePtr> again = bracket(args, Size(64, 48), depth,
+                { 0.25, 1, 4, 16 });
+        again.erase(again.begin());
+        HDRCreator freshCreator(args);
+        kernel::GenericFramePtr fresh(new kernel::GenericFrame(args));
+        ASSERT_TRUE(freshCreator.create(fresh, again));
+        EXPECT_EQ(0, maxDifference(fresh->getRawFrame(), output->getRawFrame())) << depth;
+    }
+}
+
+TEST(HDRCreatorCase, FailedMergeDropsDecodedWindow)
+{
+    GlobalArgs_t args = testArgs(true, "", 0, NULL);
+    args.rollingWindow = true;
+    std::vector<kernel::GenericFramePtr> frames = bracket(args, Size(64, 48), CV_32F);
+    HDRCreator creator(args);
+    kernel::GenericFramePtr output(new kernel::GenericFrame(args));
+    ASSERT_TRUE(creator.create(output, frames));
+
+    // Frame of one channel passes validation, but it isn't decoded.
+    std::vector<kernel::GenericFramePtr> broken(frames);
+    Mat gray(48, 64, CV_32F, Scalar::all(0.5));
+    broken[2] = kernel::GenericFramePtr(
+            new kernel::GenericFrame(args, gray, kernel::GenericFrame::COLOR_BGR));
+    EXPECT_FALSE(creator.create(kernel::GenericFramePtr(new kernel::GenericFrame(args)), broken));
+
+    testing::internal::CaptureStdout();
+    ASSERT_TRUE(creator.create(output, frames));
+    EXPECT_NE(std::string::npos, testing::internal::GetCapturedStdout().find(
+            "0 of 3 frame(s) of the window decoded before"));
+
+    HDRCreator freshCreator(args);
+    kernel::GenericFramePtr fresh(new kernel::GenericFrame(args));
+    ASSERT_TRUE(freshCreator.create(fresh, frames));
+    EXPECT_EQ(0, maxDifference(fresh->getRawFrame(), output->getRawFrame()));
+}
+
+TEST(HDRCreatorCase, HalfChromaOfOddSize)
+{
+    const Size size(65, 47);
+    GlobalArgs_t args = testArgs(true, "", 0, NULL);
+    GlobalArgs_t halfArgs = args;
+    halfArgs.halfChroma = true;
+
+    // Flat a*b* stays flat through 2x2 means and upsampling, both paths blur
+    // the same constant. Only float rounding of weights of the blur and of
+    // the upsampling is allowed.
+    const float a = 16, b = -32;
+    std::vector<kernel::GenericFramePtr> flat, flatAgain;
+    for (kernel::GenericFramePtr & frame : bracket(args, size, CV_32F))
+    {
+        Mat lab;
+        cvtColor(frame->getRawFrame(), lab, COLOR_BGR2Lab);
+        std::vector<Mat> channels;
+        split(lab, channels);
+        channels[1].setTo(a);
+        channels[2].setTo(b);
+        merge(channels, lab);
+        Mat copy = lab.clone();
+        flat.push_back(kernel::GenericFramePtr(
+                new kernel::GenericFrame(args, lab, kernel::GenericFrame::COLOR_CIELab)));
+        flatAgain.push_back(kernel::GenericFramePtr(
+                new kernel::GenericFrame(args, copy, kernel::GenericFrame::COLOR_CIELab)));
+    }
+    kernel::GenericFramePtr full(new kernel::GenericFrame(args));
+    ASSERT_TRUE(HDRCreator(args).create(full, flat));
+    kernel::GenericFramePtr half(new kernel::GenericFrame(halfArgs));
+    ASSERT_TRUE(HDRCreator(halfArgs).create(half, flatAgain));
+    ASSERT_EQ(size, half->getRawFrame().size());
+    EXPECT_LE(maxDifference(full->getRawFrame(), half->getRawFrame()), 1e-4);
+    std::vector<Mat> channels;
+    split(half->getRawFrame(), channels);
+    EXPECT_LE(maxDifference(channels[1], Mat(size, CV_32F, Scalar::all(a))), 1e-4);
+    EXPECT_LE(maxDifference(channels[2], Mat(size, CV_32F, Scalar::all(b))), 1e-4);
+
+    // Luminance doesn't depend on chromaticity, a*b* of a smooth scene are close.
+    std::vector<kernel::GenericFramePtr> frames = bracket(args, size, CV_32F);
+    ASSERT_TRUE(HDRCreator(args).create(full, frames));
+    frames = bracket(args, size, CV_32F);
+    ASSERT_TRUE(HDRCreator(halfArgs).create(half, frames));
+    ASSERT_EQ(size, half->getRawFrame().size());
+    Mat difference;
+    absdiff(full->getRawFrame(), half->getRawFrame(), difference);
+    split(difference, channels);
+    EXPECT_EQ(0, maxDifference(channels[0], Mat::zeros(size, CV_32F)));
+    for (int ch = 1; ch < 3; ++ch)
+    {
+        double maxAb = 0;
+        minMaxLoc(channels[ch], NULL, &maxAb);
+        RecordProperty(ch == 1 ? "maxDifferenceA" : "maxDifferenceB", std::to_string(maxAb));
+        EXPECT_LT(mean(channels[ch])[0], 2) << ch;
+    }
+}
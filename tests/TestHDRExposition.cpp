@@ -0,0 +1,460 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "kernel/HDRExposition.hpp"
+
+using namespace std;
+using namespace kernel;
+using namespace cv;
+
+class Scale: public Preprocess<float>
+{
+private:
+    double factor;
+public:
+    explicit Scale(double factor)
+            : factor(factor)
+    {
+    }
+    virtual Mat & preprocess(Mat & m)
+    {
+        m.convertTo(m, -1, factor);
+        return m;
+    }
+    virtual bool isElementWise() const
+    {
+        return true;
+    }
+};
+
+class Average: public GlobalOperation<float>
+{
+public:
+    virtual float process(float inputs[], unsigned int exps)
+    {
+        float sum = 0;
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            sum += inputs[exp];
+        }
+        return sum / exps;
+    }
+};
+
+class SpanAverage: public Average
+{
+public:
+    virtual void processSpan(const float * const inputs[], unsigned int exps, float * output,
+            size_t length)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            float sum = 0;
+            for (unsigned int exp = 0; exp < exps; ++exp)
+            {
+                sum += inputs[exp][i];
+            }
+            output[i] = sum / exps;
+        }
+    }
+};
+
+/**
+ * Average of fixed-point pixels.
+ */
+template<typename PixelType>
+class IntegerAverage: public GlobalOperation<PixelType>
+{
+public:
+    virtual PixelType process(PixelType inputs[], unsigned int exps)
+    {
+        unsigned int sum = 0;
+        for (unsigned int exp = 0; exp < exps; ++exp)
+        {
+            sum += inputs[exp];
+        }
+        return (sum + exps / 2) / exps;
+    }
+};
+
+/**
+ * Partition from label matrix.
+ */
+class LabelPartition: public Partition<float, unsigned char, unsigned int>
+{
+public:
+    explicit LabelPartition(const Mat & labels, unsigned char noOfLabels)
+    {
+        for (unsigned char label = 0; label < noOfLabels; ++label)
+        {
+            spans_t spans;
+            for (int row = 0; row < labels.rows; ++row)
+            {
+                for (int col = 0; col < labels.cols; ++col)
+                {
+                    if (labels.at<unsigned char>(row, col) == label)
+                    {
+                        addPixel(spans, row, col);
+                    }
+                }
+            }
+            partitions.push_back(make_pair(label, spans));
+        }
+        noOfPartitions = noOfLabels;
+    }
+    virtual void apply(vector<Mat> & inputs)
+    {
+    }
+    virtual Mat & preprocess(Mat & m)
+    {
+        return m;
+    }
+};
+
+/**
+ * Counts pixels of every area, serially or with merged area states.
+ */
+class AreaCounter: public LocalOperation<float, unsigned char, unsigned int>
+{
+private:
+    bool mergeable;
+    unsigned char ident;
+
+    struct CounterState: public AreaState
+    {
+        size_t pixels;
+    };
+public:
+    vector<size_t> pixels;
+
+    AreaCounter(Partition<float, unsigned char, unsigned int> & partitions, bool mergeable)
+            : LocalOperation<float, unsigned char, unsigned int>(partitions), mergeable(mergeable)
+    {
+    }
+    virtual float process(float inputs[], unsigned int exps)
+    {
+        pixels[ident]++;
+        return ident;
+    }
+    virtual void enterArea(unsigned char ident)
+    {
+        this->ident = ident;
+        pixels.resize(size(), 0);
+    }
+    virtual void leaveArea(unsigned char ident)
+    {
+    }
+    virtual bool isMergeable() const
+    {
+        return mergeable;
+    }
+    virtual AreaStatePtr createAreaState(unsigned char ident)
+    {
+        CounterState * state = new CounterState();
+        state->pixels = 0;
+        return AreaStatePtr(state);
+    }
+    virtual void processAreaSpan(AreaState & state, const float * const inputs[],
+            unsigned int exps, float * output, size_t length)
+    {
+        static_cast<CounterState &>(state).pixels += length;
+    }
+    virtual void mergeArea(unsigned char ident, AreaState & state)
+    {
+        pixels[ident] += static_cast<CounterState &>(state).pixels;
+    }
+};
+
+struct MinMaxSum
+{
+    float min, max;
+    double sum;
+};
+
+class MinMaxMean: public GlobalReduction<float, MinMaxSum>
+{
+public:
+    virtual MinMaxSum initial()
+    {
+        return MinMaxSum
+        { std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), 0 };
+    }
+    virtual void accumulate(MinMaxSum & acc, const float * const inputs[], unsigned int exps,
+            size_t length)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            acc.min = std::min(acc.min, inputs[0][i]);
+            acc.max = std::max(acc.max, inputs[0][i]);
+            acc.sum += inputs[0][i];
+        }
+    }
+    virtual void combine(MinMaxSum & acc, const MinMaxSum & other)
+    {
+        acc.min = std::min(acc.min, other.min);
+        acc.max = std::max(acc.max, other.max);
+        acc.sum += other.sum;
+    }
+};
+
+class AreaSum: public LocalReduction<float, unsigned char, unsigned int, double>
+{
+public:
+    AreaSum(Partition<float, unsigned char, unsigned int> & partitions)
+            : LocalReduction<float, unsigned char, unsigned int, double>(partitions)
+    {
+    }
+    virtual double initial(unsigned char ident)
+    {
+        return 0;
+    }
+    virtual void accumulate(double & acc, const float * const inputs[], unsigned int exps,
+            size_t length)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            acc += inputs[0][i];
+        }
+    }
+    virtual void combine(double & acc, const double & other)
+    {
+        acc += other;
+    }
+};
+
+class HDRExpositionTestCase: public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        for (int exp = 0; exp < 3; ++exp)
+        {
+            Mat m(37, 53, CV_32F);
+            randu(m, 0, 1);
+            inputs.push_back(m);
+        }
+    }
+
+    Mat run(size_t tileBytes, vector<Mat> & processedInputs)
+    {
+        Mat output(inputs.front().size(), CV_32F);
+        processedInputs.clear();
+        for_each(inputs.begin(), inputs.end(), [&processedInputs](Mat & m)
+        {
+            processedInputs.push_back(m.clone());
+        });
+
+        Scale opScale(2);
+        Average opAverage;
+        HDRExposition<float> expositions(output, processedInputs);
+        expositions.setTileBytes(tileBytes);
+        expositions.addOperation(opScale);
+        expositions.addOperation(opAverage);
+        expositions.process();
+        return output;
+    }
+
+    vector<Mat> inputs;
+};
+
+TEST_F(HDRExpositionTestCase, TileStreamingEqualsWholeFrame)
+{
+    vector<Mat> wholeInputs, tiledInputs;
+    Mat whole = run(0, wholeInputs);
+    Mat tiled = run(1, tiledInputs); // one row per tile
+
+    EXPECT_EQ(0, norm(whole, tiled, NORM_INF));
+    for (unsigned int exp = 0; exp < inputs.size(); ++exp)
+    {
+        // Preprocess has to be applied in place, on the original frames.
+        EXPECT_EQ(0, norm(wholeInputs[exp], tiledInputs[exp], NORM_INF));
+        EXPECT_NEAR(2 * sum(inputs[exp])[0], sum(tiledInputs[exp])[0], 1e-2);
+    }
+}
+
+TEST_F(HDRExpositionTestCase, SpanProcessingEqualsPixelProcessing)
+{
+    Mat pixelOutput(inputs.front().size(), CV_32F), spanOutput(inputs.front().size(), CV_32F);
+    Average opAverage;
+    SpanAverage opSpanAverage;
+    opAverage.apply(pixelOutput, inputs);
+    opSpanAverage.apply(spanOutput, inputs);
+
+    EXPECT_EQ(0, norm(pixelOutput, spanOutput, NORM_INF));
+}
+
+TEST(PartitionCase, SpansCoverPartition)
+{
+    // A = 0, B = 1
+    unsigned char l[] = { 0, 1, 1, 0, 1, 0,
+                          0, 0, 1, 1, 1, 0 };
+    Mat labels(2, 6, CV_8U, l);
+    LabelPartition partition(labels, 2);
+    typedef LabelPartition::span_t span_t;
+
+    const LabelPartition::spans_t & spansA = partition.spans(0);
+    const LabelPartition::spans_t & spansB = partition.spans(1);
+    const span_t expectedA[] = { { 0, 0, 1 }, { 0, 3, 1 }, { 0, 5, 1 }, { 1, 0, 2 }, { 1, 5, 1 } };
+    const span_t expectedB[] = { { 0, 1, 2 }, { 0, 4, 1 }, { 1, 2, 3 } };
+
+    ASSERT_EQ(5u, spansA.size());
+    for (unsigned int i = 0; i < spansA.size(); ++i)
+    {
+        EXPECT_EQ(expectedA[i].row, spansA[i].row);
+        EXPECT_EQ(expectedA[i].start, spansA[i].start);
+        EXPECT_EQ(expectedA[i].length, spansA[i].length);
+    }
+    ASSERT_EQ(3u, spansB.size());
+    for (unsigned int i = 0; i < spansB.size(); ++i)
+    {
+        EXPECT_EQ(expectedB[i].row, spansB[i].row);
+        EXPECT_EQ(expectedB[i].start, spansB[i].start);
+        EXPECT_EQ(expectedB[i].length, spansB[i].length);
+    }
+    EXPECT_EQ(6u, partition.size(0));
+    EXPECT_EQ(6u, partition.size(1));
+
+    // Pixel iterator walks spans in order.
+    Mat values(2, 6, CV_32F);
+    for (int i = 0; i < 12; ++i)
+    {
+        values.at<float>(i / 6, i % 6) = i;
+    }
+    vector<float> visited;
+    for_each(partition.begin<float>(values, 1), partition.end<float>(values, 1),
+            [&visited](float v)
+            {
+                visited.push_back(v);
+            });
+    const float expectedVisited[] = { 1, 2, 4, 8, 9, 10 };
+    EXPECT_EQ(vector<float>(expectedVisited, expectedVisited + 6), visited);
+}
+
+TEST_F(HDRExpositionTestCase, MergedAreasEqualSerialAreas)
+{
+    Mat labels(inputs.front().size(), CV_8U);
+    randu(labels, 0, 4);
+    LabelPartition partition(labels, 4);
+    Mat output(inputs.front().size(), CV_32F);
+
+    AreaCounter serial(partition, false), merged(partition, true);
+    serial.apply(output, inputs);
+    merged.apply(output, inputs);
+
+    ASSERT_EQ(4u, merged.pixels.size());
+    EXPECT_EQ(serial.pixels, merged.pixels);
+    for (unsigned char ident = 0; ident < 4; ++ident)
+    {
+        EXPECT_EQ(partition.size(ident), merged.pixels[ident]);
+    }
+}
+
+TEST_F(HDRExpositionTestCase, GlobalReductionEqualsWholeFrame)
+{
+    Mat output;
+    MinMaxMean reduction;
+    reduction.apply(output, inputs);
+
+    double min, max;
+    minMaxLoc(inputs.front(), &min, &max);
+    EXPECT_FLOAT_EQ(min, reduction.result().min);
+    EXPECT_FLOAT_EQ(max, reduction.result().max);
+    EXPECT_NEAR(sum(inputs.front())[0], reduction.result().sum, 1e-2);
+    EXPECT_TRUE(output.empty());
+}
+
+TEST_F(HDRExpositionTestCase, LocalReductionEqualsMaskedSum)
+{
+    Mat labels(inputs.front().size(), CV_8U);
+    randu(labels, 0, 4);
+    LabelPartition partition(labels, 4);
+    Mat output(inputs.front().size(), CV_32F);
+
+    AreaSum reduction(partition);
+    reduction.apply(output, inputs);
+
+    ASSERT_EQ(4u, reduction.results().size());
+    vector<double> sums(4, 0);
+    for (int row = 0; row < labels.rows; ++row)
+    {
+        for (int col = 0; col < labels.cols; ++col)
+        {
+            sums[labels.at<unsigned char>(row, col)] += inputs.front().at<float>(row, col);
+        }
+    }
+    for (unsigned char ident = 0; ident < 4; ++ident)
+    {
+        EXPECT_NEAR(sums[ident], reduction.results()[ident], 1e-2);
+    }
+}
+
+template<typename PixelType>
+void expectFixedPointEqualsFloat(const vector<Mat> & inputs)
+{
+    const float unit = PixelTraits<PixelType>::unit();
+    vector<Mat> fixedInputs(inputs.size());
+    Mat floatOutput(inputs.front().size(), CV_32F);
+    for (unsigned int exp = 0; exp < inputs.size(); ++exp)
+    {
+        inputs[exp].convertTo(fixedInputs[exp], PixelTraits<PixelType>::depth, unit);
+    }
+    vector<Mat> floatInputs(fixedInputs.size());
+    for (unsigned int exp = 0; exp < fixedInputs.size(); ++exp)
+    {
+        fixedInputs[exp].convertTo(floatInputs[exp], CV_32F, 1. / unit);
+    }
+
+    Mat fixedOutput(inputs.front().size(), PixelTraits<PixelType>::depth);
+    IntegerAverage<PixelType> opFixed;
+    HDRExposition<PixelType> fixed(fixedOutput, fixedInputs);
+    fixed.addOperation(opFixed);
+    fixed.process();
+
+    Average opFloat;
+    HDRExposition<float> reference(floatOutput, floatInputs);
+    reference.addOperation(opFloat);
+    reference.process();
+
+    Mat fixedAsFloat;
+    fixedOutput.convertTo(fixedAsFloat, CV_32F, 1. / unit);
+    // Rounding of the fixed-point average.
+    EXPECT_LE(norm(fixedAsFloat, floatOutput, NORM_INF), 0.5 / unit + 1e-6);
+}
+
+TEST_F(HDRExpositionTestCase, FixedPointEqualsFloat)
+{
+    expectFixedPointEqualsFloat<unsigned char>(inputs);
+    expectFixedPointEqualsFloat<unsigned short>(inputs);
+}
@@ -0,0 +1,164 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "kernel/Half.hpp"
+
+using namespace kernel;
+using namespace cv;
+
+TEST(HalfCase, KnownValues)
+{
+    EXPECT_EQ(0x0000, floatToHalf(0.f));
+    EXPECT_EQ(0x8000, floatToHalf(-0.f));
+    EXPECT_EQ(0x3c00, floatToHalf(1.f));
+    EXPECT_EQ(0xc000, floatToHalf(-2.f));
+    EXPECT_EQ(0x7bff, floatToHalf(65504.f));
+    EXPECT_EQ(0x7c00, floatToHalf(65520.f)); // halfway to 65536, rounds to even
+    EXPECT_EQ(0x7c00, floatToHalf(std::numeric_limits<float>::infinity()));
+    EXPECT_EQ(0x0001, floatToHalf(std::ldexp(1.f, -24)));
+    EXPECT_EQ(0x0400, floatToHalf(std::ldexp(1.f, -14)));
+    // 1 + 2^-11 is halfway between 1 and the next half, ties to even.
+    EXPECT_EQ(0x3c00, floatToHalf(1.f + std::ldexp(1.f, -11)));
+    EXPECT_EQ(0x3c02, floatToHalf(1.f + 3 * std::ldexp(1.f, -11)));
+    EXPECT_TRUE(std::isnan(halfToFloat(floatToHalf(std::nanf("")))));
+}
+
+TEST(HalfCase, EveryHalfRoundTrips)
+{
+    for (unsigned int h = 0; h < 0x10000; ++h)
+    {
+        if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff)) continue; // NaN
+        ASSERT_EQ(h, floatToHalf(halfToFloat(h))) << std::hex << h;
+    }
+}
+
+/**
+ * Error of half storage against float over the range of a*b*, [-128, 128].
+ * The bound is half of the spacing of halves in [64, 128), 1/32.
+ */
+TEST(HalfCase, ChromaticityError)
+{
+    std::mt19937 generator(18);
+    std::uniform_real_distribution<float> ab(-128, 128);
+    const size_t length = 1 << 20;
+    std::vector<float> values(length), restored(length);
+    std::vector<unsigned short> halves(length);
+    for (size_t i = 0; i < length; ++i)
+    {
+        values[i] = ab(generator);
+    }
+    floatToHalf(values.data(), halves.data(), length);
+    halfToFloat(halves.data(), restored.data(), length);
+    double maxError = 0, sumError = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        const double error = std::abs(double(values[i]) - restored[i]);
+        maxError = std::max(maxError, error);
+        sumError += error;
+    }
+    RecordProperty("maxError", std::to_string(maxError));
+    RecordProperty("meanError", std::to_string(sumError / length));
+    EXPECT_LE(maxError, 1. / 32);
+}
+
+TEST(HalfCase, SpansEqualScalar)
+{
+    std::mt19937 generator(16);
+    std::uniform_real_distribution<float> value(-70000, 70000);
+    const size_t lengths[] = { 1, 7, 8, 9, 100, 1001 };
+    for (size_t length : lengths)
+    {
+        std::vector<float> values(length), restored(length);
+        std::vector<unsigned short> halves(length);
+        for (size_t i = 0; i < length; ++i)
+        {
+            // Values near and beyond every range of halves.
+            values[i] = std::ldexp(value(generator), -int(i % 40));
+        }
+        floatToHalf(values.data(), halves.data(), length);
+        halfToFloat(halves.data(), restored.data(), length);
+        for (size_t i = 0; i < length; ++i)
+        {
+            ASSERT_EQ(floatToHalf(values[i]), halves[i]) << values[i];
+            ASSERT_EQ(halfToFloat(halves[i]), restored[i]) << values[i];
+        }
+    }
+}
+
+TEST(HalfCase, MatrixConversion)
+{
+    Mat halves(3, 5, CV_16UC2), widened;
+    for (int row = 0; row < halves.rows; ++row)
+    {
+        for (int col = 0; col < halves.cols; ++col)
+        {
+            Vec2h & h = halves.at<Vec2h>(row, col);
+            h = Vec2h(row - 1.5f, col * 0.25f);
+        }
+    }
+    convertHalfToFloat(halves, widened);
+    ASSERT_EQ(CV_32FC2, widened.type());
+    for (int row = 0; row < halves.rows; ++row)
+    {
+        for (int col = 0; col < halves.cols; ++col)
+        {
+            EXPECT_EQ(row - 1.5f, widened.at<Vec2f>(row, col)[0]);
+            EXPECT_EQ(col * 0.25f, widened.at<Vec2f>(row, col)[1]);
+        }
+    }
+    Mat narrowed;
+    convertFloatToHalf(widened, narrowed);
+    ASSERT_EQ(CV_16UC2, narrowed.type());
+    EXPECT_EQ(0, countNonZero(narrowed.reshape(1) != halves.reshape(1)));
+}
+
+/**
+ * Throughput of conversions, half of the bytes of float are moved.
+ */
+TEST(HalfCase, ConversionSpeed)
+{
+    const size_t length = 1 << 22;
+    std::vector<float> values(length, 1.5f), restored(length);
+    std::vector<unsigned short> halves(length);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    floatToHalf(values.data(), halves.data(), length);
+    halfToFloat(halves.data(), restored.data(), length);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+            - start).count();
+    RecordProperty("MValuesPerSecond", std::to_string(2 * length / seconds / 1e6));
+    EXPECT_EQ(1.5f, restored[length - 1]);
+}
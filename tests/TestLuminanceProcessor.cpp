@@ -0,0 +1,166 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "kernel/HdrCreation/LuminanceProcessor.hpp"
+#include "testArgs.hpp"
+
+using namespace HDRCreation;
+using namespace cv;
+
+namespace
+{
+
+/**
+ * Luminances of 3 expositions (gains 1/4, 1, 4) of depth @param depth of a scene
+ * of random constant blocks of 2^@param levels pixels.
+ */
+std::vector<Mat> blockBracket(const Size & size, unsigned int levels, int depth)
+{
+    Mat blocks(((size.height - 1) >> levels) + 1, ((size.width - 1) >> levels) + 1, CV_32F);
+    theRNG().state = 16;
+    randu(blocks, Scalar::all(0.02), Scalar::all(1));
+    Mat scene(size, CV_32F);
+    for (int row = 0; row < size.height; ++row)
+    {
+        for (int col = 0; col < size.width; ++col)
+        {
+            scene.at<float>(row, col) = blocks.at<float>(row >> levels, col >> levels);
+        }
+    }
+    std::vector<Mat> exposures;
+    const double gains[] = { 0.25, 1, 4 };
+    const double unit = (depth == CV_16U) ? 65535 : 1;
+    for (double gain : gains)
+    {
+        Mat exposed = cv::min(Mat(scene * gain), 1.), converted;
+        exposed.convertTo(converted, depth, unit);
+        exposures.push_back(converted);
+    }
+    return exposures;
+}
+
+/**
+ * Luminance of @param inputs (copied) mapped with statistics on proxy of @param levels.
+ */
+template<typename PixelType>
+Mat mapLuminance(const std::vector<Mat> & inputs, unsigned int levels, double & minValue,
+        double & maxValue)
+{
+    GlobalArgs_t args = testArgs(true, "", 0, NULL);
+    std::vector<kernel::GenericFramePtr> frames;
+    std::vector<Mat> corrected;
+    for (const Mat & input : inputs)
+    {
+        frames.push_back(kernel::GenericFramePtr(new kernel::GenericFrame(args)));
+        corrected.push_back(input.clone());
+    }
+    kernel::BufferPool pool;
+    LuminanceProcessor<PixelType> processor(frames, pool, levels);
+    Mat output(inputs.front().size(), inputs.front().type());
+    EXPECT_TRUE(processor.mapLuminance(output, corrected, minValue, maxValue));
+    return output;
+}
+
+}
+
+TEST(LuminanceProcessorCase, ProxyOfOddSizeKeepsBlocks)
+{
+    // Edges between blocks of 2^levels pixels stay sharp in the proxy, also
+    // when the size isn't a multiple of 2^levels.
+    const unsigned int levels = 2;
+    const Size sizes[] = { Size(37, 23), Size(33, 17), Size(40, 29) };
+    for (const Size & size : sizes)
+    {
+        Mat input(size, CV_32F);
+        for (int row = 0; row < size.height; ++row)
+        {
+            for (int col = 0; col < size.width; ++col)
+            {
+                input.at<float>(row, col) = ((row >> levels) * 100 + (col >> levels)) * 1.f;
+            }
+        }
+        Mat proxy, padded;
+        LuminanceProcessor<float>::decimate(input, proxy, levels, padded);
+        ASSERT_EQ(Size((size.width + 3) / 4, (size.height + 3) / 4), proxy.size());
+        for (int row = 0; row < proxy.rows; ++row)
+        {
+            for (int col = 0; col < proxy.cols; ++col)
+            {
+                EXPECT_NEAR((row * 100 + col) * 1.f, proxy.at<float>(row, col), 1e-3)
+                        << size << " at " << Point(col, row);
+            }
+        }
+    }
+}
+
+TEST(LuminanceProcessorCase, ProxyLevelsKeepPixels)
+{
+    EXPECT_TRUE(validProxyLevels(Size(37, 23), 0));
+    EXPECT_TRUE(validProxyLevels(Size(37, 23), 4));
+    EXPECT_FALSE(validProxyLevels(Size(37, 23), 5));
+    EXPECT_FALSE(validProxyLevels(Size(37, 23), 31));
+    EXPECT_FALSE(validProxyLevels(Size(37, 23), 40));
+}
+
+TEST(LuminanceProcessorCase, ProxyOfConstantBlocksEqualsFullResolution)
+{
+    // Areas of blocks and their statistics are the same on the proxy and at full
+    // resolution, so is the output. Frames are tiled, labels of the proxy are looked up
+    // by the position of tiles and ranges of tiles are merged.
+    const unsigned int levels = 2;
+    const Size size(516, 388);
+    {
+        const std::vector<Mat> inputs = blockBracket(size, levels, CV_16U);
+        double minFull = 0, maxFull = 0, minProxy = 0, maxProxy = 0;
+        Mat full = mapLuminance<unsigned short>(inputs, 0, minFull, maxFull);
+        Mat proxy = mapLuminance<unsigned short>(inputs, levels, minProxy, maxProxy);
+        // Sums of integers are exact, proxy sums are 2^(2 levels) times smaller.
+        EXPECT_EQ(minFull, minProxy);
+        EXPECT_EQ(maxFull, maxProxy);
+        EXPECT_EQ(0, countNonZero(full != proxy));
+    }
+    {
+        const std::vector<Mat> inputs = blockBracket(size, levels, CV_32F);
+        double minFull = 0, maxFull = 0, minProxy = 0, maxProxy = 0;
+        Mat full = mapLuminance<float>(inputs, 0, minFull, maxFull);
+        Mat proxy = mapLuminance<float>(inputs, levels, minProxy, maxProxy);
+        // Float sums differ only in the order of summation.
+        EXPECT_NEAR(minFull, minProxy, 1e-6);
+        EXPECT_NEAR(maxFull, maxProxy, 1e-6);
+        Mat difference;
+        absdiff(full, proxy, difference);
+        double maxDifference = 0;
+        minMaxLoc(difference, NULL, &maxDifference);
+        EXPECT_LE(maxDifference, 1e-5);
+    }
+}
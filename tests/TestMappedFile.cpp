@@ -0,0 +1,106 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include "kernel/MappedFile.hpp"
+
+using namespace kernel;
+
+/**
+ * New file with @param content, its name to @param name.
+ */
+static void temporaryFile(const std::string & content, std::string & name)
+{
+    char pattern[] = "/tmp/MappedFileTestXXXXXX";
+    int fd = mkstemp(pattern);
+    ASSERT_LE(0, fd);
+    name = pattern;
+    const ssize_t written = write(fd, content.data(), content.size());
+    close(fd);
+    ASSERT_EQ(static_cast<ssize_t>(content.size()), written);
+}
+
+TEST(MappedFileCase, MappedBytesAreFileContent)
+{
+    const std::string content = "HDR Simple Framework\n";
+    std::string name;
+    ASSERT_NO_FATAL_FAILURE(temporaryFile(content, name));
+    MappedFile file;
+    ASSERT_TRUE(file.open(name));
+    EXPECT_TRUE(file.isOpen());
+    ASSERT_EQ(content.size(), file.size());
+    EXPECT_EQ(0, memcmp(content.data(), file.bytes(), content.size()));
+    unlink(name.c_str());
+}
+
+TEST(MappedFileCase, ClosedFileIsNotMapped)
+{
+    std::string name;
+    ASSERT_NO_FATAL_FAILURE(temporaryFile("data", name));
+    MappedFile file;
+    ASSERT_TRUE(file.open(name));
+    file.close();
+    EXPECT_FALSE(file.isOpen());
+    EXPECT_EQ(0u, file.size());
+    EXPECT_EQ(NULL, file.bytes());
+    unlink(name.c_str());
+}
+
+TEST(MappedFileCase, MissingOrEmptyFileIsNotMapped)
+{
+    std::string name;
+    ASSERT_NO_FATAL_FAILURE(temporaryFile("", name));
+    MappedFile file;
+    EXPECT_FALSE(file.open(name));
+    unlink(name.c_str());
+    EXPECT_FALSE(file.open(name));
+    EXPECT_FALSE(file.isOpen());
+    MappedFile::prefetch(name); // no-op for missing files
+}
+
+TEST(MappedFileCase, PartlyReadFileIsMapped)
+{
+    // Without advice for reading the whole file, the mapping is the same.
+    const std::string content(3 * 4096 + 17, 'x');
+    std::string name;
+    ASSERT_NO_FATAL_FAILURE(temporaryFile(content, name));
+    MappedFile file;
+    ASSERT_TRUE(file.open(name, false));
+    ASSERT_EQ(content.size(), file.size());
+    EXPECT_EQ('x', file.bytes()[0]);
+    EXPECT_EQ('x', file.bytes()[content.size() - 1]);
+    EXPECT_EQ(0, memcmp(content.data(), file.bytes(), content.size()));
+    unlink(name.c_str());
+}
@@ -0,0 +1,77 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "kernel/RadianceWriter.hpp"
+
+using namespace kernel;
+using namespace cv;
+
+namespace
+{
+
+Mat randomLab(int rows, int cols)
+{
+    Mat lab(rows, cols, CV_32FC3);
+    randu(lab, Scalar(0, -50, -50), Scalar(100, 50, 50));
+    return lab;
+}
+
+}
+
+TEST(RadianceWriterCase, StripsAreReadAsWholeImage)
+{
+    const char * filename = "radiance_writer_test.hdr";
+    Mat lab = randomLab(37, 29);
+    RadianceWriter writer;
+    ASSERT_TRUE(writer.open(filename, lab.cols, lab.rows));
+    ASSERT_TRUE(writer.write(lab.rowRange(0, 16), 0));
+    ASSERT_TRUE(writer.write(lab.rowRange(16, 32), 16));
+    ASSERT_TRUE(writer.write(lab.rowRange(32, 37), 32));
+    ASSERT_TRUE(writer.close());
+
+    Mat expected, read = imread(filename, IMREAD_ANYDEPTH | IMREAD_COLOR);
+    cvtColor(lab, expected, COLOR_Lab2BGR);
+    ASSERT_EQ(expected.size(), read.size());
+    ASSERT_EQ(CV_32FC3, read.type());
+    // 8-bit mantissa with shared exponent.
+    EXPECT_LT(norm(expected, read, NORM_INF), 1. / 64);
+}
+
+TEST(RadianceWriterCase, StripsOutOfOrderAreRejected)
+{
+    Mat lab = randomLab(8, 4);
+    RadianceWriter writer;
+    ASSERT_TRUE(writer.open("radiance_writer_order.hdr", lab.cols, lab.rows));
+    EXPECT_FALSE(writer.write(lab.rowRange(4, 8), 4));
+    ASSERT_TRUE(writer.write(lab.rowRange(0, 4), 0));
+    EXPECT_FALSE(writer.close()); // incomplete
+}
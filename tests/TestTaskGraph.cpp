@@ -0,0 +1,105 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+
+#include "kernel/TaskGraph.hpp"
+#include "kernel/WorkerPool.hpp"
+
+using namespace std;
+using namespace kernel;
+
+TEST(TaskGraphCase, DependenciesAreFinishedFirst)
+{
+    TaskGraph graph;
+    atomic<int> counter(0);
+    vector<int> order(6, -1);
+    TaskGraph::dependencies_t leaves;
+    for (int task = 0; task < 4; ++task)
+    {
+        leaves.push_back(graph.add("leaf", [&counter, &order, task]()
+        {
+            order[task] = counter++;
+            return true;
+        }));
+    }
+    TaskGraph::task_t join = graph.add("join", [&counter, &order]()
+    {
+        order[4] = counter++;
+        return true;
+    }, leaves);
+    graph.add("last", [&counter, &order]()
+    {
+        order[5] = counter++;
+        return true;
+    }, join);
+
+    WorkerPool pool(3);
+    EXPECT_TRUE(graph.run(pool));
+    for (int task = 0; task < 4; ++task)
+    {
+        EXPECT_LT(order[task], order[4]);
+    }
+    EXPECT_EQ(5, order[5]);
+}
+
+TEST(TaskGraphCase, FailureSkipsDependents)
+{
+    TaskGraph graph;
+    atomic<int> runs(0);
+    TaskGraph::task_t failing = graph.add("failing", [&runs]()
+    {
+        runs++;
+        return false;
+    });
+    TaskGraph::task_t independent = graph.add("independent", [&runs]()
+    {
+        runs++;
+        return true;
+    });
+    TaskGraph::task_t dependent = graph.add("dependent", [&runs]()
+    {
+        runs++;
+        return true;
+    }, failing);
+    TaskGraph::dependencies_t both;
+    both.push_back(dependent);
+    both.push_back(independent);
+    graph.add("transitive", [&runs]()
+    {
+        runs++;
+        return true;
+    }, both);
+
+    EXPECT_FALSE(graph.run());
+    EXPECT_EQ(2, runs);
+    EXPECT_NE(string::npos, graph.describe().find("skipped"));
+}
@@ -0,0 +1,146 @@
+/*
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Piotr Dobrowolski
+ *
+ *  permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ */
+/*
+ * Author: Piotr Dobrowolski
+ * dobrypd[at]gmail[dot]com
+ *
+ */
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+
+#include "kernel/WorkerPool.hpp"
+
+using namespace kernel;
+
+TEST(WorkerPoolCase, AllJobsAreExecuted)
+{
+    WorkerPool pool(4);
+    WorkerPool::Group group;
+    std::atomic<int> sum(0);
+    for (int job = 1; job <= 100; ++job)
+    {
+        pool.submit(group, [&sum, job]()
+        {
+            sum += job;
+        });
+    }
+    pool.wait(group);
+    EXPECT_EQ(5050, sum);
+}
+
+TEST(WorkerPoolCase, NestedGroupsDoNotDeadlock)
+{
+    // Every thread waits for nested jobs, waiting threads have to execute them.
+    WorkerPool pool(2);
+    WorkerPool::Group outer;
+    std::atomic<int> executed(0);
+    for (int job = 0; job < 8; ++job)
+    {
+        pool.submit(outer, [&pool, &executed]()
+        {
+            WorkerPool::Group inner;
+            for (int nested = 0; nested < 8; ++nested)
+            {
+                pool.submit(inner, [&executed]()
+                {
+                    executed++;
+                });
+            }
+            pool.wait(inner);
+        });
+    }
+    pool.wait(outer);
+    EXPECT_EQ(64, executed);
+}
+
+TEST(WorkerPoolCase, SingleThreadRunsOnCaller)
+{
+    WorkerPool pool(1);
+    EXPECT_EQ(1u, pool.size());
+    WorkerPool::Group group;
+    boost::thread::id caller = boost::this_thread::get_id();
+    bool onCaller = false;
+    pool.submit(group, [&onCaller, caller]()
+    {
+        onCaller = (boost::this_thread::get_id() == caller);
+    });
+    pool.wait(group);
+    EXPECT_TRUE(onCaller);
+}
+
+TEST(WorkerPoolCase, JobExceptionIsRethrownByWait)
+{
+    WorkerPool pool(4);
+    WorkerPool::Group group;
+    std::atomic<int> executed(0);
+    for (int job = 0; job < 16; ++job)
+    {
+        pool.submit(group, [&executed, job]()
+        {
+            executed++;
+            if (job % 4 == 0) throw std::runtime_error("job failed");
+        });
+    }
+    EXPECT_THROW(pool.wait(group), std::runtime_error);
+    EXPECT_EQ(16, executed);
+
+    // Error is reported once, the group can be reused.
+    pool.submit(group, [&executed]()
+    {
+        executed++;
+    });
+    EXPECT_NO_THROW(pool.wait(group));
+    EXPECT_EQ(17, executed);
+}
+
+TEST(WorkerPoolCase, GroupsOfManyThreadsFinish)
+{
+    // Jobs are submitted and stolen concurrently, every wait is woken by the last job
+    // of its group.
+    WorkerPool pool(4);
+    std::atomic<int> executed(0);
+    boost::thread_group submitters;
+    for (int thread = 0; thread < 4; ++thread)
+    {
+        submitters.create_thread([&pool, &executed]()
+        {
+            for (int round = 0; round < 200; ++round)
+            {
+                WorkerPool::Group group;
+                for (int job = 0; job < 4; ++job)
+                {
+                    pool.submit(group, [&executed]()
+                    {
+                        executed++;
+                    });
+                }
+                pool.wait(group);
+            }
+        });
+    }
+    submitters.join_all();
+    EXPECT_EQ(4 * 200 * 4, executed);
+}
@@ -44,6 +44,13 @@ GlobalArgs_t testArgs(bool createHDR, const char* outputFile, int inputFilesNo,
     newArgs.outputFile = outputFile;
     newArgs.realTime = false;
     newArgs.verbosity = 10;
+    newArgs.halfChroma = false;
+    newArgs.proxyLevels = 0;
+    newArgs.strips = 0;
+    newArgs.halfFloat = false;
+    newArgs.rollingWindow = false;
+    newArgs.align = 0;
+    newArgs.rawPreset = 0; // quality
 
     newArgs.inputs = inputFilesNo;
     newArgs.inputFiles = inputFiles;